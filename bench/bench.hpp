@@ -0,0 +1,119 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+
+#include "../lib/session/session.hpp"
+
+/*
+    Helpers shared by the benchmarks.
+
+    The server runs in a child process (TCPServer is a singleton and its run() blocks),
+    its output is discarded. The parent measures the requests sent through Session.
+*/
+
+using BenchClock = std::chrono::steady_clock;
+
+// Forks the process which runs `serve`, returns its pid.
+inline pid_t spawn_server(std::function<void()> serve)
+{
+    pid_t pid = fork();
+    if(pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+
+        // exit() instead of _exit(), so the profile of a PGO=gen build is written.
+        serve();
+        exit(0);
+    }
+
+    return pid;
+}
+
+// Stops the server with Ctrl+C first, kills it if it doesn't exit in time.
+inline void stop_server(pid_t pid)
+{
+    kill(pid, SIGINT);
+    for(int i = 0; i < 100; i++) {
+        if(waitpid(pid, nullptr, WNOHANG) == pid)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+// Retries to connect while the server is starting up.
+inline Session* connect_session(const std::string& addr, short port)
+{
+    for(int attempt = 0; attempt < 200; attempt++) {
+        Session* session = new Session(addr, port);
+        try {
+            session->connect_to_service();
+            return session;
+        }
+        catch(const Session::SessionError&) {
+            delete session;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    throw Session::SessionError("Benchmark server didn't start.");
+}
+
+struct LatencyReport {
+    double seconds;
+    size_t requests;
+    size_t bytes;
+    std::vector<double> latencies_us;
+
+    void print(const std::string& name)
+    {
+        std::sort(latencies_us.begin(), latencies_us.end());
+        auto percentile = [&](double p) {
+            return latencies_us.empty() ? 0.0 : latencies_us[(size_t) (p * (latencies_us.size() - 1))];
+        };
+
+        std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << requests / seconds << " req/s"
+                  << std::setw(10) << bytes / seconds / (1024 * 1024) << " MiB/s"
+                  << "   p50 " << std::setw(8) << percentile(0.50) << " us"
+                  << "   p99 " << std::setw(8) << percentile(0.99) << " us" << std::endl;
+    }
+};
+
+// Sends `requests` requests over `session` and measures every round trip.
+inline LatencyReport round_trips(Session& session, const std::string& request, size_t requests)
+{
+    LatencyReport report = {0, requests, 0, {}};
+    report.latencies_us.reserve(requests);
+
+    auto start = BenchClock::now();
+    for(size_t i = 0; i < requests; i++) {
+        auto sent = BenchClock::now();
+        session.send_data(request);
+        report.bytes += session.receive_data().size() + request.size();
+        report.latencies_us.push_back(
+            std::chrono::duration<double, std::micro>(BenchClock::now() - sent).count());
+    }
+    report.seconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+
+    return report;
+}
+
+#endif // BENCH_HPP
@@ -0,0 +1,33 @@
+#include "bench.hpp"
+
+#include "../lib/server/server.hpp"
+
+/*
+    Round trips of an echo handler in sequential and parallel server modes.
+
+    Usage: echo_bench [requests] [payload size]
+*/
+
+#define PORT 5600
+
+int main(int argc, char** argv)
+{
+    size_t requests = argc > 1 ? std::stoul(argv[1]) : 20000;
+    size_t payload = argc > 2 ? std::stoul(argv[2]) : 64;
+    std::string request(payload, 'x');
+
+    for(bool parallel : {false, true}) {
+        pid_t server = spawn_server([=] {
+            TCPServer* tcp_server = TCPServer::instantiate("127.0.0.1", PORT + parallel, 16);
+            tcp_server->set_handler([](const std::string& data) { return data; });
+            tcp_server->run(parallel, 2);
+        });
+
+        Session* session = connect_session("127.0.0.1", PORT + parallel);
+        LatencyReport report = round_trips(*session, request, requests);
+        delete session;
+        stop_server(server);
+
+        report.print(parallel ? "echo parallel" : "echo sequential");
+    }
+}
@@ -0,0 +1,131 @@
+#include "bench.hpp"
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "../lib/server/server.hpp"
+
+/*
+    Large file responses: a handler that reads the file into a string
+    versus a file handler that the server transmits with sendfile().
+
+    The responses are received from a raw socket with a large buffer, so the client isn't the bottleneck.
+    Besides the throughput the server CPU time per response is reported.
+
+    Usage: file_bench [requests] [file size]
+*/
+
+#define PORT 5620
+#define FILE_PATH "/tmp/tcpserver_file_bench.dat"
+#define RECV_BUFSIZE (1 << 20)
+
+static int connect_raw(short port)
+{
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    for(int attempt = 0; attempt < 200; attempt++) {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if(connect(sock, (struct sockaddr*) &addr, sizeof(addr)) == 0)
+            return sock;
+
+        close(sock);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    throw std::runtime_error("Benchmark server didn't start.");
+}
+
+// Requests the file `requests` times, every response has to be `size` bytes and the trailer.
+static LatencyReport download(int sock, size_t size, size_t requests)
+{
+    LatencyReport report = {0, requests, 0, {}};
+    std::vector<char> buffer(RECV_BUFSIZE);
+
+    auto start = BenchClock::now();
+    for(size_t i = 0; i < requests; i++) {
+        auto sent = BenchClock::now();
+        if(write(sock, "get\n\n", 5) != 5)
+            throw std::runtime_error("Sending the request failed.");
+
+        size_t received = 0;
+        while(received < size + 2) {
+            ssize_t bytes = read(sock, buffer.data(), buffer.size());
+            if(bytes <= 0)
+                throw std::runtime_error("Server has closed the connection.");
+            received += bytes;
+        }
+        if(received != size + 2)
+            throw std::runtime_error("Unexpected response size.");
+
+        report.bytes += size;
+        report.latencies_us.push_back(
+            std::chrono::duration<double, std::micro>(BenchClock::now() - sent).count());
+    }
+    report.seconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+
+    return report;
+}
+
+static double children_cpu_ms()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+         + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+}
+
+int main(int argc, char** argv)
+{
+    size_t requests = argc > 1 ? std::stoul(argv[1]) : 50;
+    size_t size = argc > 2 ? std::stoul(argv[2]) : 64 * 1024 * 1024;
+
+    // the trailer can't appear inside the file.
+    {
+        std::ofstream file(FILE_PATH, std::ios::binary);
+        std::string block(1024 * 1024, 'x');
+        for(size_t left = size; left > 0; left -= std::min(left, block.size()))
+            file.write(block.data(), std::min(left, block.size()));
+    }
+
+    for(bool zero_copy : {false, true}) {
+        double cpu_before = children_cpu_ms();
+
+        pid_t server = spawn_server([=] {
+            TCPServer* tcp_server = TCPServer::instantiate("127.0.0.1", PORT + zero_copy, 16);
+            if(zero_copy) {
+                tcp_server->set_file_handler([](const std::string&) { return file_response(FILE_PATH); });
+            }
+            else {
+                tcp_server->set_handler([](const std::string&) {
+                    std::ifstream file(FILE_PATH, std::ios::binary);
+                    std::ostringstream content;
+                    content << file.rdbuf();
+                    return content.str();
+                });
+            }
+            tcp_server->run(false);
+        });
+
+        int sock = connect_raw(PORT + zero_copy);
+        download(sock, size, 2);
+
+        std::string name = (zero_copy ? "sendfile " : "string ") + std::to_string(size / 1024) + " KiB";
+        download(sock, size, requests).print(name);
+
+        close(sock);
+        stop_server(server);
+
+        std::cout << std::left << std::setw(28) << "" << "server CPU "
+                  << (children_cpu_ms() - cpu_before) / (requests + 2) << " ms per response" << std::endl;
+    }
+
+    unlink(FILE_PATH);
+}
@@ -0,0 +1,73 @@
+#include "bench.hpp"
+
+#include "../lib/server/server.hpp"
+
+/*
+    Loopback TCP (IPv4, IPv6) versus Unix domain sockets (filesystem, abstract namespace)
+    versus the shared-memory channel (futex and spin modes, negotiated over a Unix socket).
+
+    Every transport is measured with a small request (latency) and a large one (throughput)
+    through the same echo handler.
+
+    Usage: transport_bench [requests] [large payload size]
+*/
+
+#define PORT 5610
+
+struct Transport {
+    std::string name;
+    std::string host;
+    short port;
+    int shm; // 0 - socket only, 1 - shared memory, 2 - shared memory in spin mode.
+};
+
+int main(int argc, char** argv)
+{
+    size_t requests = argc > 1 ? std::stoul(argv[1]) : 20000;
+    size_t large = argc > 2 ? std::stoul(argv[2]) : 256 * 1024;
+
+    std::vector<Transport> transports = {
+        {"tcp 127.0.0.1", "127.0.0.1", PORT, 0},
+        {"tcp [::1]", "::1", PORT + 1, 0},
+        {"unix socket file", "unix:/tmp/tcpserver_bench.sock", 0, 0},
+        {"unix abstract", "unix:@tcpserver_bench", 0, 0},
+        {"shm futex", "unix:@tcpserver_bench_shm", 0, 1},
+        {"shm spin", "unix:@tcpserver_bench_shm", 0, 2},
+    };
+
+    for(auto& transport : transports) {
+        pid_t server = spawn_server([=] {
+            TCPServer* tcp_server = TCPServer::instantiate(transport.host, transport.port, 16);
+            tcp_server->set_handler([](const std::string& data) { return data; });
+            tcp_server->enable_shared_memory();
+            // the channels are served only in parallel mode, one thread is enough for one session.
+            tcp_server->run(transport.shm != 0);
+        });
+
+        Session* session;
+        try {
+            session = connect_session(transport.host, transport.port);
+        }
+        catch(const Session::SessionError& err) {
+            std::cout << transport.name << ": " << err.what() << std::endl;
+            stop_server(server);
+            continue;
+        }
+
+        if(transport.shm && !session->use_shared_memory(1 << 20, transport.shm == 2)) {
+            std::cout << transport.name << ": the server declined shared memory." << std::endl;
+            delete session;
+            stop_server(server);
+            continue;
+        }
+
+        round_trips(*session, "warmup", 1000);
+
+        round_trips(*session, std::string(64, 'x'), requests).print(transport.name + " 64 B");
+        round_trips(*session, std::string(large, 'x'), std::max(requests / 100, (size_t) 10))
+            .print(transport.name + " " + std::to_string(large / 1024) + " KiB");
+
+        delete session;
+        stop_server(server);
+    }
+}
@@ -1,9 +1,19 @@
 CXX=g++
-CXXFLAGS=-c
+# The headers of the library need C++17.
+CXXFLAGS=-std=c++17 -O2 -pthread -c
 LDFLAGS=-pthread
+LDLIBS=
+
+# Needed if the library is built with the optional codecs.
+ifeq ($(LZ4),1)
+LDLIBS+=-llz4
+endif
+ifeq ($(ZSTD),1)
+LDLIBS+=-lzstd
+endif
 
 COMPILE=$(CXX) $(CXXFLAGS) $<
-LINK=$(CXX) $(LDFLAGS) $*.o lib/objects/lib.o -o $*
+LINK=$(CXX) $(LDFLAGS) $*.o lib/objects/lib.o $(LDLIBS) -o $*
 REMOVE_OBJECT=rm $*.o
 
 %: %.cpp
@@ -0,0 +1,109 @@
+#include "batcher.hpp"
+
+Batcher::Batcher(BatchHandler _handler, size_t _max_batch_size, std::chrono::microseconds _window)
+    :handler(_handler), max_batch_size(_max_batch_size > 0 ? _max_batch_size : 1), window(_window),
+     stopping(false), max_submitters(0), counters()
+{
+    counters.max_batch_size = max_batch_size;
+    counters.window = window;
+
+    worker = std::thread([this] { work(); });
+}
+
+Batcher::~Batcher()
+{
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        stopping = true;
+    }
+
+    cv.notify_all();
+    worker.join();
+}
+
+void Batcher::set_max_submitters(size_t submitters)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    max_submitters = submitters;
+}
+
+std::string Batcher::submit(const std::string& request)
+{
+    std::future<std::string> response;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        queue.push_back({request, std::promise<std::string>()});
+        response = queue.back().response.get_future();
+    }
+    cv.notify_all();
+
+    return response.get();
+}
+
+void Batcher::work()
+{
+    while(true) {
+        std::vector<Pending> batch;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return stopping || !queue.empty(); });
+
+            if(stopping && queue.empty()) return;
+
+            // waits for the batch to be filled up, but no longer than the window.
+            auto deadline = std::chrono::steady_clock::now() + window;
+            bool full = cv.wait_until(lock, deadline, [this] {
+                return stopping ||
+                       queue.size() >= max_batch_size ||
+                       (max_submitters > 0 && queue.size() >= max_submitters);
+            });
+
+            if(!full)
+                counters.flushed_by_window++;
+            else if(queue.size() >= max_batch_size)
+                counters.flushed_by_size++;
+            else
+                counters.flushed_by_submitters++;
+
+            size_t size = std::min(queue.size(), max_batch_size);
+            batch.reserve(size);
+            for(size_t i = 0; i < size; i++)
+                batch.push_back(std::move(queue[i]));
+            queue.erase(queue.begin(), queue.begin() + size);
+
+            counters.batches++;
+            counters.requests += size;
+            counters.largest_batch = std::max(counters.largest_batch, (uint64_t) size);
+        }
+
+        process(batch);
+    }
+}
+
+void Batcher::process(std::vector<Pending>& batch)
+{
+    std::vector<std::string> requests;
+    requests.reserve(batch.size());
+    for(auto& pending : batch)
+        requests.push_back(std::move(pending.request));
+
+    try {
+        std::vector<std::string> responses = handler(requests);
+        if(responses.size() != batch.size()) {
+            throw BatchError("Batch handler returned wrong number of responses.");
+        }
+
+        for(size_t i = 0; i < batch.size(); i++)
+            batch[i].response.set_value(std::move(responses[i]));
+    }
+    catch(...) {
+        for(auto& pending : batch)
+            pending.response.set_exception(std::current_exception());
+    }
+}
+
+Batcher::Stats Batcher::stats()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    return counters;
+}
@@ -0,0 +1,94 @@
+#ifndef BATCHER_HPP
+#define BATCHER_HPP
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <exception>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <cstdint>
+
+/*
+    Collects the requests submitted by different threads into batches
+    and processes each batch with one call of the batch handler.
+
+    A batch is handed to the handler when it reaches max size, when the window
+    since its first request elapses or when all the threads that can submit are waiting,
+    so nobody can add one more request anyway.
+    The handler has to return exactly one response per request, in the same order.
+*/
+
+class Batcher {
+public:
+    using BatchHandler = std::function<std::vector<std::string>(const std::vector<std::string>&)>;
+
+    class BatchError : public std::exception {
+        std::string msg;
+    public:
+        BatchError(const std::string& _msg)
+            :msg(_msg)
+        {}
+
+        const char* what() const noexcept
+        { return msg.c_str(); }
+    };
+
+    struct Stats {
+        size_t max_batch_size;
+        std::chrono::microseconds window;
+
+        uint64_t batches;
+        uint64_t requests;
+        uint64_t largest_batch;
+
+        uint64_t flushed_by_size;
+        uint64_t flushed_by_window;
+        uint64_t flushed_by_submitters;
+    };
+private:
+    struct Pending {
+        std::string request;
+        std::promise<std::string> response;
+    };
+
+    BatchHandler handler;
+    size_t max_batch_size;
+    std::chrono::microseconds window;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Pending> queue;
+    bool stopping;
+
+    // each submitter has at most one request in the queue.
+    size_t max_submitters;
+
+    Stats counters;
+
+    std::thread worker;
+    void work();
+    void process(std::vector<Pending>&);
+public:
+    Batcher(BatchHandler, size_t max_batch_size, std::chrono::microseconds window);
+
+    Batcher(Batcher&) = delete;
+    Batcher(const Batcher&) = delete;
+    Batcher(Batcher&&) = delete;
+
+    Batcher& operator=(const Batcher&) = delete;
+
+    ~Batcher();
+
+    void set_max_submitters(size_t);
+
+    std::string submit(const std::string&);
+
+    Stats stats();
+};
+
+#endif // BATCHER_HPP
@@ -0,0 +1,103 @@
+#include "response_cache.hpp"
+
+#include "../utils/utils.hpp"
+
+// Approximate bookkeeping cost of one entry (list node, index node, control block).
+#define ENTRY_OVERHEAD 128
+
+ResponseCache::ResponseCache(size_t max_bytes, std::chrono::milliseconds _ttl, int num_of_shards)
+    :shards(num_of_shards > 0 ? num_of_shards : 1), ttl(_ttl), hits(0), misses(0)
+{
+    shard_capacity = max_bytes / shards.size();
+}
+
+void ResponseCache::erase(Shard& shard, std::list<Entry>::iterator it)
+{
+    shard.bytes -= it->charge;
+    shard.index.erase(it->hash);
+    shard.lru.erase(it);
+}
+
+ResponseCache::Response ResponseCache::lookup(const std::string& request)
+{
+    uint64_t hash = hash_bytes(request.data(), request.size());
+    Shard& shard = shard_of(hash);
+
+    {
+        std::unique_lock<std::mutex> lock(shard.mtx);
+
+        auto found = shard.index.find(hash);
+        if(found != shard.index.end() && found->second->request == request) {
+            auto it = found->second;
+
+            if(ttl.count() > 0 && it->expires <= Clock::now()) {
+                erase(shard, it);
+                shard.expirations++;
+            }
+            else {
+                // moves the entry to the front, so it's evicted last.
+                shard.lru.splice(shard.lru.begin(), shard.lru, it);
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return it->response;
+            }
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void ResponseCache::insert(const std::string& request, Response response)
+{
+    size_t charge = request.size() + response->size() + ENTRY_OVERHEAD;
+    if(charge > shard_capacity)
+        return;
+
+    uint64_t hash = hash_bytes(request.data(), request.size());
+    Shard& shard = shard_of(hash);
+
+    std::unique_lock<std::mutex> lock(shard.mtx);
+
+    // the newer response replaces the old one as well as a colliding entry.
+    auto found = shard.index.find(hash);
+    if(found != shard.index.end())
+        erase(shard, found->second);
+
+    while(shard.bytes + charge > shard_capacity) {
+        erase(shard, std::prev(shard.lru.end()));
+        shard.evictions++;
+    }
+
+    shard.lru.push_front({hash, request, std::move(response), Clock::now() + ttl, charge});
+    shard.index[hash] = shard.lru.begin();
+    shard.bytes += charge;
+    shard.insertions++;
+}
+
+void ResponseCache::clear()
+{
+    for(auto& shard : shards) {
+        std::unique_lock<std::mutex> lock(shard.mtx);
+        shard.lru.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+ResponseCache::Stats ResponseCache::stats()
+{
+    Stats result = {};
+    result.hits = hits.load(std::memory_order_relaxed);
+    result.misses = misses.load(std::memory_order_relaxed);
+
+    for(auto& shard : shards) {
+        std::unique_lock<std::mutex> lock(shard.mtx);
+        result.insertions += shard.insertions;
+        result.evictions += shard.evictions;
+        result.expirations += shard.expirations;
+        result.bytes += shard.bytes;
+        result.entries += shard.lru.size();
+    }
+
+    return result;
+}
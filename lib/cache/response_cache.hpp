@@ -0,0 +1,89 @@
+#ifndef RESPONSE_CACHE_HPP
+#define RESPONSE_CACHE_HPP
+
+#include <list>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*
+    Sharded LRU cache of responses.
+
+    Maps a request to the response which was formed for it. Responses are kept
+    already framed, so a hit can be written to the socket as is.
+    The cache is split into shards selected by the request hash, each shard
+    has its own lock and its own part of the byte limit.
+*/
+
+class ResponseCache {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Response = std::shared_ptr<const std::string>;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t insertions;
+        uint64_t evictions;
+        uint64_t expirations;
+
+        size_t bytes;
+        size_t entries;
+    };
+private:
+    struct Entry {
+        uint64_t hash;
+        std::string request;
+        Response response;
+        Clock::time_point expires;
+        size_t charge;
+    };
+
+    struct Shard {
+        std::mutex mtx;
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        uint64_t expirations = 0;
+    };
+
+    std::vector<Shard> shards;
+    size_t shard_capacity;
+    std::chrono::milliseconds ttl;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+
+    Shard& shard_of(uint64_t hash)
+    { return shards[(hash >> 32) % shards.size()]; }
+
+    void erase(Shard&, std::list<Entry>::iterator);
+public:
+    ResponseCache(size_t max_bytes,
+                  std::chrono::milliseconds ttl = std::chrono::milliseconds(0),
+                  int num_of_shards = 16);
+
+    ResponseCache(ResponseCache&) = delete;
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache(ResponseCache&&) = delete;
+
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    Response lookup(const std::string&);
+    void insert(const std::string&, Response);
+
+    void clear();
+
+    Stats stats();
+};
+
+#endif // RESPONSE_CACHE_HPP
@@ -10,6 +10,7 @@
 #include <string.h>
 
 #include <iostream>
+#include <algorithm>
 
 Client* Client::singleton = nullptr;
 
@@ -23,7 +24,7 @@ Client::Client()
     signal(SIGINT, signal_handler);
 }
 
-void Client::signal_handler(int signum)
+void Client::signal_handler(int)
 {
     // prints the newline character after ^C.
     std::cout << std::endl;
@@ -91,7 +92,7 @@ void Client::print_info()
 {
     std::string dynamic_line = "| The server address is " + 
                                 (session->service_info).endpoint + 
-                                std::string(50 - (session->service_info).endpoint.size(), ' ') +
+                                std::string(std::max(50 - (int) (session->service_info).endpoint.size(), 0), ' ') +
                                 "|\n";
 
     std::cout << "|=========================================================================|\n"
@@ -0,0 +1,312 @@
+#include "codec.hpp"
+
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+#include <sstream>
+#include <memory>
+#include <algorithm>
+
+#ifdef TCPSERVER_WITH_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef TCPSERVER_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Max number of raw bytes in one block.
+#define BLOCK_SIZE (64 * 1024)
+#define HEADER_SIZE 9
+
+#define LAST_BLOCK 0x80
+#define CODEC_MASK 0x0f
+
+#define ZSTD_LEVEL 1
+
+static const char* COMPRESS_COMMAND = "COMPRESS";
+
+CompressionStats CompressionCounters::snapshot() const
+{
+    return {sent_messages.load(), sent_raw_bytes.load(), sent_wire_bytes.load(),
+            received_messages.load(), received_raw_bytes.load(), received_wire_bytes.load(),
+            compressed_blocks.load(), skipped_blocks.load(),
+            compress_ns.load(), decompress_ns.load()};
+}
+
+std::vector<Codec> supported_codecs()
+{
+    std::vector<Codec> codecs;
+#ifdef TCPSERVER_WITH_ZSTD
+    codecs.push_back(Codec::Zstd);
+#endif
+#ifdef TCPSERVER_WITH_LZ4
+    codecs.push_back(Codec::LZ4);
+#endif
+    return codecs;
+}
+
+std::string codec_name(Codec codec)
+{
+    switch(codec) {
+        case Codec::LZ4:  return "lz4";
+        case Codec::Zstd: return "zstd";
+        default:          return "none";
+    }
+}
+
+bool parse_codec(const std::string& name, Codec& codec)
+{
+    for(Codec candidate : {Codec::None, Codec::LZ4, Codec::Zstd}) {
+        if(codec_name(candidate) == name) {
+            codec = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string compression_offer()
+{
+    std::string offer = std::string(1, CONTROL_BYTE) + COMPRESS_COMMAND;
+    for(Codec codec : supported_codecs())
+        offer += " " + codec_name(codec);
+
+    return offer;
+}
+
+bool is_compression_offer(const std::string& request)
+{
+    std::string prefix = std::string(1, CONTROL_BYTE) + COMPRESS_COMMAND;
+    if(request.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    return request.size() == prefix.size() || request[prefix.size()] == ' ';
+}
+
+Codec choose_codec(const std::string& offer)
+{
+    std::istringstream iss(offer.substr(1));
+    std::string word;
+    iss >> word;
+
+    std::vector<Codec> supported = supported_codecs();
+    while(iss >> word) {
+        Codec codec;
+        if(!parse_codec(word, codec))
+            continue;
+
+        for(Codec own : supported)
+            if(own == codec)
+                return codec;
+    }
+
+    return Codec::None;
+}
+
+std::string compression_answer(Codec codec)
+{ return std::string(1, CONTROL_BYTE) + COMPRESS_COMMAND + " " + codec_name(codec); }
+
+bool parse_compression_answer(const std::string& answer, Codec& codec)
+{
+    std::string prefix = std::string(1, CONTROL_BYTE) + COMPRESS_COMMAND + " ";
+    if(answer.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    return parse_codec(answer.substr(prefix.size()), codec);
+}
+
+static uint64_t thread_cpu_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void put_u32(char* dst, uint32_t value)
+{
+    dst[0] = value >> 24;
+    dst[1] = value >> 16;
+    dst[2] = value >> 8;
+    dst[3] = value;
+}
+
+static uint32_t get_u32(const char* src)
+{
+    const unsigned char* p = (const unsigned char*) src;
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static bool write_all(int fd, const char* data, size_t size)
+{
+    while(size > 0) {
+        ssize_t bytes = write(fd, data, size);
+        if(bytes <= 0)
+            return false;
+        data += bytes;
+        size -= bytes;
+    }
+
+    return true;
+}
+
+static int read_all(int fd, char* data, size_t size)
+{
+    while(size > 0) {
+        ssize_t bytes = read(fd, data, size);
+        if(bytes < 0)
+            return -1;
+        if(bytes == 0)
+            return 0;
+        data += bytes;
+        size -= bytes;
+    }
+
+    return 1;
+}
+
+// Per-thread buffer for compressed blocks, grown once to the max block bound.
+static std::vector<char>& block_buffer()
+{
+    thread_local std::vector<char> buffer(HEADER_SIZE + BLOCK_SIZE + BLOCK_SIZE / 8 + 1024);
+    return buffer;
+}
+
+// Returns the size of the compressed data or 0 if the block can't be compressed.
+static size_t compress_block(Codec codec, const char* src, size_t size, char* dst, size_t capacity)
+{
+#ifdef TCPSERVER_WITH_LZ4
+    if(codec == Codec::LZ4) {
+        thread_local std::vector<char> state(LZ4_sizeofState());
+        int bytes = LZ4_compress_fast_extState(state.data(), src, dst, size, capacity, 1);
+        return bytes > 0 ? bytes : 0;
+    }
+#endif
+#ifdef TCPSERVER_WITH_ZSTD
+    if(codec == Codec::Zstd) {
+        thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        size_t bytes = ZSTD_compressCCtx(cctx.get(), dst, capacity, src, size, ZSTD_LEVEL);
+        return ZSTD_isError(bytes) ? 0 : bytes;
+    }
+#endif
+    // without the codec libraries nothing is compressed and the arguments are unused.
+    (void) codec; (void) src; (void) size; (void) dst; (void) capacity;
+    return 0;
+}
+
+static bool decompress_block(Codec codec, const char* src, size_t size, char* dst, size_t raw_size)
+{
+#ifdef TCPSERVER_WITH_LZ4
+    if(codec == Codec::LZ4) {
+        return LZ4_decompress_safe(src, dst, size, raw_size) == (int) raw_size;
+    }
+#endif
+#ifdef TCPSERVER_WITH_ZSTD
+    if(codec == Codec::Zstd) {
+        thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        size_t bytes = ZSTD_decompressDCtx(dctx.get(), dst, raw_size, src, size);
+        return !ZSTD_isError(bytes) && bytes == raw_size;
+    }
+#endif
+    (void) codec; (void) src; (void) size; (void) dst; (void) raw_size;
+    return false;
+}
+
+bool send_message(int fd, const char* data, size_t size, Codec codec, size_t threshold,
+                  CompressionCounters& counters)
+{
+    std::vector<char>& buffer = block_buffer();
+    if(size < threshold)
+        codec = Codec::None;
+
+    size_t offset = 0;
+    do {
+        size_t raw_size = std::min(size - offset, (size_t) BLOCK_SIZE);
+        bool last = offset + raw_size == size;
+
+        size_t wire_size = 0;
+        if(codec != Codec::None && raw_size > 0) {
+            uint64_t start = thread_cpu_ns();
+            wire_size = compress_block(codec, data + offset, raw_size,
+                                       buffer.data() + HEADER_SIZE, buffer.size() - HEADER_SIZE);
+            counters.compress_ns += thread_cpu_ns() - start;
+        }
+
+        // sends the block as is if it isn't compressed or doesn't shrink.
+        bool compressed = wire_size > 0 && wire_size < raw_size;
+        buffer[0] = (compressed ? (unsigned char) codec : 0) | (last ? LAST_BLOCK : 0);
+        put_u32(buffer.data() + 1, raw_size);
+        put_u32(buffer.data() + 5, compressed ? wire_size : raw_size);
+
+        if(compressed) {
+            counters.compressed_blocks++;
+            if(!write_all(fd, buffer.data(), HEADER_SIZE + wire_size))
+                return false;
+        }
+        else {
+            counters.skipped_blocks++;
+            wire_size = raw_size;
+            if(!write_all(fd, buffer.data(), HEADER_SIZE) || !write_all(fd, data + offset, raw_size))
+                return false;
+        }
+
+        counters.sent_raw_bytes += raw_size;
+        counters.sent_wire_bytes += HEADER_SIZE + wire_size;
+        offset += raw_size;
+    } while(offset < size);
+
+    counters.sent_messages++;
+    return true;
+}
+
+int receive_message(int fd, std::string& result, CompressionCounters& counters)
+{
+    std::vector<char>& buffer = block_buffer();
+    result.clear();
+
+    while(true) {
+        char header[HEADER_SIZE];
+        int status = read_all(fd, header, HEADER_SIZE);
+        if(status <= 0)
+            return status;
+
+        Codec codec = (Codec) (header[0] & CODEC_MASK);
+        uint32_t raw_size = get_u32(header + 1);
+        uint32_t wire_size = get_u32(header + 5);
+        if(raw_size > BLOCK_SIZE || wire_size > buffer.size())
+            return -1;
+
+        size_t offset = result.size();
+        result.resize(offset + raw_size);
+
+        if(codec == Codec::None) {
+            if(wire_size != raw_size)
+                return -1;
+            status = read_all(fd, &result[offset], raw_size);
+        }
+        else {
+            status = read_all(fd, buffer.data(), wire_size);
+            if(status > 0) {
+                uint64_t start = thread_cpu_ns();
+                bool decompressed = decompress_block(codec, buffer.data(), wire_size, &result[offset], raw_size);
+                counters.decompress_ns += thread_cpu_ns() - start;
+
+                if(!decompressed)
+                    return -1;
+            }
+        }
+        if(status <= 0)
+            return status;
+
+        counters.received_raw_bytes += raw_size;
+        counters.received_wire_bytes += HEADER_SIZE + wire_size;
+
+        if(header[0] & LAST_BLOCK)
+            break;
+    }
+
+    counters.received_messages++;
+    return 1;
+}
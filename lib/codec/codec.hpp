@@ -0,0 +1,78 @@
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include <vector>
+#include <string>
+
+#include <atomic>
+#include <cstdint>
+
+#include "../utils/utils.hpp"
+
+/*
+    Payload compression used by server and session modules.
+
+    Compression is negotiated per connection: the session sends a control request
+    with the codecs it supports, the server answers with the chosen one.
+    After that both sides exchange the messages as a sequence of blocks:
+
+        [flags: 1 byte][raw size: 4 bytes][wire size: 4 bytes][wire size bytes of payload]
+
+    The low bits of flags hold the codec of the block, LAST_BLOCK bit marks the end of a message.
+    Messages are split into blocks of BLOCK_SIZE bytes, so large bodies are compressed and sent
+    block by block. Messages smaller than the threshold and blocks that don't shrink are sent as is.
+
+    LZ4 and zstd are available if the library is built with TCPSERVER_WITH_LZ4 / TCPSERVER_WITH_ZSTD.
+    Compression contexts and buffers are kept per thread and reused for every message.
+*/
+
+enum class Codec : unsigned char { None = 0, LZ4 = 1, Zstd = 2 };
+
+// Sent and received data are counted separately, so each direction has its own ratio.
+struct CompressionStats {
+    uint64_t sent_messages;
+    uint64_t sent_raw_bytes;
+    uint64_t sent_wire_bytes;
+    uint64_t received_messages;
+    uint64_t received_raw_bytes;
+    uint64_t received_wire_bytes;
+    uint64_t compressed_blocks;
+    uint64_t skipped_blocks;
+    uint64_t compress_ns;
+    uint64_t decompress_ns;
+};
+
+struct CompressionCounters {
+    std::atomic<uint64_t> sent_messages{0};
+    std::atomic<uint64_t> sent_raw_bytes{0};
+    std::atomic<uint64_t> sent_wire_bytes{0};
+    std::atomic<uint64_t> received_messages{0};
+    std::atomic<uint64_t> received_raw_bytes{0};
+    std::atomic<uint64_t> received_wire_bytes{0};
+    std::atomic<uint64_t> compressed_blocks{0};
+    std::atomic<uint64_t> skipped_blocks{0};
+    std::atomic<uint64_t> compress_ns{0};
+    std::atomic<uint64_t> decompress_ns{0};
+
+    CompressionStats snapshot() const;
+};
+
+std::vector<Codec> supported_codecs();
+
+std::string codec_name(Codec);
+bool parse_codec(const std::string&, Codec&);
+
+// Builds the control request offering the supported codecs.
+std::string compression_offer();
+bool is_compression_offer(const std::string&);
+// Picks the first supported codec of the offer, Codec::None if there is no such codec.
+Codec choose_codec(const std::string&);
+std::string compression_answer(Codec);
+bool parse_compression_answer(const std::string&, Codec&);
+
+// Returns false if the message wasn't sent entirely.
+bool send_message(int, const char*, size_t, Codec, size_t, CompressionCounters&);
+// Returns 1 if a message is received, 0 if the connection is closed, -1 if something went wrong.
+int receive_message(int, std::string&, CompressionCounters&);
+
+#endif // CODEC_HPP
@@ -0,0 +1,140 @@
+#include "file_response.hpp"
+
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <vector>
+#include <algorithm>
+
+// The most sendfile() and splice() transfer in one call.
+#define MAX_TRANSFER 0x7ffff000
+// Buffer of the read() / write() fallback.
+#define COPY_BUFSIZE (64 * 1024)
+
+FileResponse file_response(const std::string& path)
+{
+    FileResponse response;
+
+    struct stat st;
+    response.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(response.fd < 0 || fstat(response.fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        release_file(response);
+        response.text = "File not found.";
+        return response;
+    }
+
+    response.length = st.st_size;
+    return response;
+}
+
+static bool write_all(int fd, const char* data, size_t size)
+{
+    while(size > 0) {
+        ssize_t bytes = write(fd, data, size);
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        if(bytes <= 0)
+            return false;
+
+        data += bytes;
+        size -= bytes;
+    }
+    return true;
+}
+
+// pipes can't be read at an offset, they are read from the current position.
+static ssize_t read_at(int fd, char* buffer, size_t size, off_t offset, bool seekable)
+{ return seekable ? pread(fd, buffer, size, offset) : read(fd, buffer, size); }
+
+// used when the kernel can't transfer the descriptor to the socket by itself.
+static bool copy_file(int sock, int fd, off_t offset, size_t left)
+{
+    std::vector<char> buffer(std::min(left, (size_t) COPY_BUFSIZE));
+    bool seekable = lseek(fd, 0, SEEK_CUR) >= 0;
+
+    while(left > 0) {
+        ssize_t bytes = read_at(fd, buffer.data(), std::min(left, buffer.size()), offset, seekable);
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        if(bytes <= 0 || !write_all(sock, buffer.data(), bytes))
+            return false;
+
+        offset += bytes;
+        left -= bytes;
+    }
+    return true;
+}
+
+static bool splice_pipe(int sock, int fd, size_t left)
+{
+    while(left > 0) {
+        ssize_t bytes = splice(fd, NULL, sock, NULL, std::min(left, (size_t) MAX_TRANSFER),
+                               SPLICE_F_MOVE | SPLICE_F_MORE);
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        if(bytes < 0 && errno == EINVAL)
+            return copy_file(sock, fd, 0, left);
+        if(bytes <= 0)
+            return false;
+
+        left -= bytes;
+    }
+    return true;
+}
+
+bool send_file(int sock, const FileResponse& file)
+{
+    struct stat st;
+    if(fstat(file.fd, &st) < 0)
+        return false;
+
+    // sendfile() needs a descriptor it can map, splice() moves the pages of a pipe.
+    if(S_ISFIFO(st.st_mode))
+        return splice_pipe(sock, file.fd, file.length);
+
+    off_t offset = file.offset;
+    size_t left = file.length;
+
+    while(left > 0) {
+        ssize_t bytes = sendfile(sock, file.fd, &offset, std::min(left, (size_t) MAX_TRANSFER));
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        if(bytes < 0 && (errno == EINVAL || errno == ENOSYS))
+            return copy_file(sock, file.fd, offset, left);
+        // the file is shorter than the region.
+        if(bytes <= 0)
+            return false;
+
+        left -= bytes;
+    }
+    return true;
+}
+
+bool read_file(const FileResponse& file, std::string& result)
+{
+    result.resize(file.length);
+    bool seekable = lseek(file.fd, 0, SEEK_CUR) >= 0;
+
+    size_t done = 0;
+    while(done < file.length) {
+        ssize_t bytes = read_at(file.fd, &result[done], file.length - done, file.offset + done, seekable);
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        if(bytes <= 0)
+            return false;
+
+        done += bytes;
+    }
+    return true;
+}
+
+void release_file(FileResponse& file)
+{
+    if(file.close_fd && file.fd >= 0)
+        close(file.fd);
+
+    file.fd = -1;
+}
@@ -0,0 +1,43 @@
+#ifndef FILE_RESPONSE_HPP
+#define FILE_RESPONSE_HPP
+
+#include <sys/types.h>
+
+#include <string>
+#include <functional>
+
+/*
+    Response that is a region of a file.
+
+    The server transmits the region with sendfile() (or splice() if the descriptor is a pipe),
+    so the bytes go from the page cache to the socket without being copied through user space.
+    Only the connections that need the bytes themselves (compressed or shared-memory ones) read them.
+*/
+
+struct FileResponse {
+    int fd = -1;
+    off_t offset = 0;
+    size_t length = 0;
+
+    // the server closes fd after the response is sent.
+    bool close_fd = true;
+
+    // sent as an ordinary response instead of the file if fd is -1, e.g. an error message.
+    std::string text;
+};
+
+using FileHandler = std::function<FileResponse(const std::string&)>;
+
+// Opens the whole file, if it can't be opened the response is "File not found.".
+FileResponse file_response(const std::string& path);
+
+// Sends the region to the socket without copying it through user space if the kernel allows it.
+bool send_file(int sock, const FileResponse&);
+
+// Reads the region into `result`.
+bool read_file(const FileResponse&, std::string& result);
+
+// Closes the descriptor if the response owns it.
+void release_file(FileResponse&);
+
+#endif // FILE_RESPONSE_HPP
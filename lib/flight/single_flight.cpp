@@ -0,0 +1,39 @@
+#include "single_flight.hpp"
+
+SingleFlight::Result SingleFlight::run(const std::string& key, const std::function<Result()>& fn)
+{
+    std::promise<Result> promise;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+
+        auto found = calls.find(key);
+        if(found != calls.end()) {
+            std::shared_future<Result> pending = found->second;
+            lock.unlock();
+
+            coalesced++;
+            return pending.get();
+        }
+
+        calls.emplace(key, promise.get_future().share());
+    }
+
+    executed++;
+    try {
+        Result result = fn();
+        promise.set_value(result);
+
+        std::unique_lock<std::mutex> lock(mtx);
+        calls.erase(key);
+
+        return result;
+    }
+    catch(...) {
+        promise.set_exception(std::current_exception());
+
+        std::unique_lock<std::mutex> lock(mtx);
+        calls.erase(key);
+
+        throw;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SINGLE_FLIGHT_HPP
+#define SINGLE_FLIGHT_HPP
+
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <cstdint>
+
+/*
+    Request coalescing.
+
+    If a call with the same key is already in flight, waits for its result
+    instead of running the function once more. All the waiters share
+    the single result (or the single exception).
+*/
+
+class SingleFlight {
+public:
+    using Result = std::shared_ptr<const std::string>;
+
+    struct Stats {
+        uint64_t executed;
+        uint64_t coalesced;
+    };
+private:
+    std::mutex mtx;
+    std::unordered_map<std::string, std::shared_future<Result>> calls;
+
+    std::atomic<uint64_t> executed;
+    std::atomic<uint64_t> coalesced;
+public:
+    SingleFlight()
+        :executed(0), coalesced(0)
+    {}
+
+    SingleFlight(SingleFlight&) = delete;
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight(SingleFlight&&) = delete;
+
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    Result run(const std::string&, const std::function<Result()>&);
+
+    Stats stats()
+    { return {executed.load(), coalesced.load()}; }
+};
+
+#endif // SINGLE_FLIGHT_HPP
@@ -48,6 +48,6 @@ void ThreadPool::stop()
 
     cv.notify_all();
 
-    for(int i = 0; i < threads.size(); i++)
+    for(size_t i = 0; i < threads.size(); i++)
         threads[i].join();
 }
\ No newline at end of file
@@ -29,7 +29,7 @@ class ThreadPool {
     std::condition_variable cv;
     bool stopping = false;
 
-    int busy_workers;
+    int busy_workers = 0;
 public:
     ThreadPool() = default;
 
@@ -49,6 +49,12 @@ public:
         std::unique_lock<std::mutex> lock(mtx);
         return busy_workers;
     }
+
+    int pending_tasks()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        return tasks.size();
+    }
     
     template<typename T>
     auto execute_task(T task)
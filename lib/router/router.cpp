@@ -0,0 +1,134 @@
+#include "router.hpp"
+
+#include "../utils/utils.hpp"
+
+// Max number of seeds tried before the perfect hash table is enlarged.
+#define MAX_SEED_TRIES 1024
+
+void Router::add_route(const std::string& command, Handler handler, bool coalesce, bool cacheable)
+{
+    if(command.empty()) {
+        throw RouterError("Route command can't be empty.");
+    }
+    if(command[0] == CONTROL_BYTE) {
+        throw RouterError("Route command can't start with the reserved control byte.");
+    }
+    if(mode == Mode::Opcode && command.size() != 1) {
+        throw RouterError("Opcode route command must be a single byte.");
+    }
+    if(mode == Mode::Token && command.find(delimiter) != std::string::npos) {
+        throw RouterError("Route command can't contain the delimiter.");
+    }
+
+    for(auto& route : routes) {
+        if(route->command == command) {
+            throw RouterError("Route '" + command + "' is already registered.");
+        }
+    }
+
+    std::unique_ptr<Route> route(new Route());
+    route->command = command;
+    route->handler = handler;
+    route->coalesce = coalesce;
+    route->cacheable = cacheable;
+    routes.push_back(std::move(route));
+
+    build();
+}
+
+void Router::build()
+{
+    if(mode == Mode::Opcode) {
+        table.assign(256, -1);
+        for(size_t i = 0; i < routes.size(); i++)
+            table[(unsigned char) routes[i]->command[0]] = i;
+        return;
+    }
+
+    std::vector<uint64_t> hashes;
+    for(auto& route : routes)
+        hashes.push_back(hash_bytes(route->command.data(), route->command.size()));
+
+    // looks for a seed that maps every command to its own slot,
+    // the table is doubled if the seed isn't found.
+    int bits = 1;
+    while((1u << bits) < 2 * routes.size())
+        bits++;
+
+    while(true) {
+        shift = 64 - bits;
+        for(seed = 1; seed <= MAX_SEED_TRIES; seed++) {
+            table.assign(1u << bits, -1);
+
+            bool collision = false;
+            for(size_t i = 0; i < hashes.size() && !collision; i++) {
+                int& entry = table[slot(hashes[i])];
+                if(entry >= 0)
+                    collision = true;
+                else
+                    entry = i;
+            }
+
+            if(!collision)
+                return;
+        }
+        bits++;
+    }
+}
+
+std::string_view Router::command_of(const std::string& request) const
+{
+    if(mode == Mode::Opcode)
+        return std::string_view(request.data(), request.empty() ? 0 : 1);
+
+    size_t end = request.find(delimiter);
+    return std::string_view(request.data(), end == std::string::npos ? request.size() : end);
+}
+
+int Router::match(const std::string& request) const
+{
+    if(routes.empty() || request.empty())
+        return -1;
+
+    std::string_view command = command_of(request);
+
+    int route;
+    if(mode == Mode::Opcode)
+        route = table[(unsigned char) command[0]];
+    else
+        route = table[slot(hash_bytes(command.data(), command.size()))];
+
+    if(route < 0 || routes[route]->command != command)
+        return -1;
+
+    return route;
+}
+
+std::string Router::call(int index, const std::string& request)
+{
+    Route& route = *routes[index];
+
+    // skips the command and the delimiter after it.
+    size_t skip = route.command.size() + (mode == Mode::Token ? 1 : 0);
+    std::string payload = request.size() > skip ? request.substr(skip) : "";
+
+    auto start = std::chrono::steady_clock::now();
+    std::string response = route.handler(payload);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    route.count.fetch_add(1, std::memory_order_relaxed);
+    route.total_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+        std::memory_order_relaxed);
+
+    return response;
+}
+
+std::vector<Router::RouteStats> Router::stats() const
+{
+    std::vector<RouteStats> result;
+    for(auto& route : routes)
+        result.push_back({route->command, route->count.load(), route->total_ns.load()});
+
+    return result;
+}
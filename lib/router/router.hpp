@@ -0,0 +1,202 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <array>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <exception>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "../utils/utils.hpp"
+
+/*
+    Dispatches the requests to the handlers by the command.
+
+    In token mode the command is the first token of the request (everything up to the delimiter),
+    in opcode mode the command is the first byte of the request.
+    The handler of a route gets the rest of the request without the command.
+
+    Token routes are looked up in a table addressed by a perfect hash which is rebuilt
+    on every registration, so a lookup is one hash of the token and one comparison.
+    Opcode routes are looked up directly in a 256-entry table.
+*/
+
+class Router {
+public:
+    using Handler = std::function<std::string(const std::string&)>;
+
+    enum class Mode { Token, Opcode };
+
+    struct RouteStats {
+        std::string command;
+        uint64_t count;
+        uint64_t total_ns;
+    };
+
+    class RouterError : public std::exception {
+        std::string msg;
+    public:
+        RouterError(const std::string& _msg)
+            :msg(_msg)
+        {}
+
+        const char* what() const noexcept
+        { return msg.c_str(); }
+    };
+private:
+    struct Route {
+        std::string command;
+        Handler handler;
+        bool coalesce;
+        bool cacheable;
+
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+    };
+    std::vector<std::unique_ptr<Route>> routes;
+
+    Mode mode;
+    char delimiter;
+
+    // perfect hash table: slot -> route index or -1.
+    std::vector<int> table;
+    uint64_t seed;
+    int shift;
+
+    size_t slot(uint64_t hash) const
+    { return ((hash ^ seed) * 0x9e3779b97f4a7c15ULL) >> shift; }
+
+    std::string_view command_of(const std::string&) const;
+
+    void build();
+public:
+    Router(Mode _mode = Mode::Token, char _delimiter = ' ')
+        :mode(_mode), delimiter(_delimiter), seed(0), shift(64)
+    {}
+
+    Router(Router&) = delete;
+    Router(const Router&) = delete;
+    Router(Router&&) = delete;
+
+    Router& operator=(const Router&) = delete;
+
+    void add_route(const std::string&, Handler, bool coalesce = false, bool cacheable = false);
+
+    bool empty() const
+    { return routes.empty(); }
+
+    int match(const std::string&) const;
+
+    bool coalesce(int route) const
+    { return routes[route]->coalesce; }
+
+    bool cacheable(int route) const
+    { return routes[route]->cacheable; }
+
+    std::string call(int, const std::string&);
+
+    std::vector<RouteStats> stats() const;
+};
+
+/*
+    Dispatch table generated at compile time.
+
+    Each route is bound to an opcode (the first byte of the request) and a handler of any callable type,
+    so the dispatch is unrolled by the compiler and the handlers can be inlined.
+    StaticRouter is callable as std::string(const std::string&), so it can be passed to TCPServer::set_handler().
+*/
+
+template<char Opcode, typename F>
+struct OpcodeRoute {
+    static constexpr char opcode = Opcode;
+    F handler;
+};
+
+template<char Opcode, typename F>
+OpcodeRoute<Opcode, F> route(F handler)
+{ return {std::move(handler)}; }
+
+template<typename... Routes>
+class StaticRouter {
+    struct Counter {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+    };
+
+    std::tuple<Routes...> routes;
+    std::shared_ptr<std::array<Counter, sizeof...(Routes)>> counters;
+
+    static constexpr bool unique_opcodes()
+    {
+        char opcodes[] = {Routes::opcode...};
+        for(size_t i = 0; i < sizeof...(Routes); i++)
+            for(size_t j = i + 1; j < sizeof...(Routes); j++)
+                if(opcodes[i] == opcodes[j])
+                    return false;
+        return true;
+    }
+    static_assert(sizeof...(Routes) > 0, "StaticRouter needs at least one route.");
+    static_assert(unique_opcodes(), "StaticRouter routes must have different opcodes.");
+    static_assert(((Routes::opcode != CONTROL_BYTE) && ...), "CONTROL_BYTE is reserved for control requests.");
+
+    template<size_t I>
+    bool try_route(char opcode, const std::string& payload, std::string& response)
+    {
+        if(opcode != std::tuple_element_t<I, std::tuple<Routes...>>::opcode)
+            return false;
+
+        auto start = std::chrono::steady_clock::now();
+        response = std::get<I>(routes).handler(payload);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        Counter& counter = (*counters)[I];
+        counter.count.fetch_add(1, std::memory_order_relaxed);
+        counter.total_ns.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+            std::memory_order_relaxed);
+        return true;
+    }
+
+    template<size_t... I>
+    bool dispatch(char opcode, const std::string& payload, std::string& response, std::index_sequence<I...>)
+    { return (try_route<I>(opcode, payload, response) || ...); }
+public:
+    StaticRouter(Routes... _routes)
+        :routes(std::move(_routes)...),
+         counters(std::make_shared<std::array<Counter, sizeof...(Routes)>>())
+    {}
+
+    std::string operator()(const std::string& request)
+    {
+        if(request.empty())
+            return "Unknown command.";
+
+        std::string response;
+        if(!dispatch(request[0], request.substr(1), response, std::index_sequence_for<Routes...>()))
+            return "Unknown command.";
+
+        return response;
+    }
+
+    std::vector<Router::RouteStats> stats() const
+    {
+        char opcodes[] = {Routes::opcode...};
+
+        std::vector<Router::RouteStats> result;
+        for(size_t i = 0; i < sizeof...(Routes); i++)
+            result.push_back({std::string(1, opcodes[i]),
+                              (*counters)[i].count.load(),
+                              (*counters)[i].total_ns.load()});
+        return result;
+    }
+};
+
+#endif // ROUTER_HPP
@@ -3,6 +3,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/select.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 
 #include <stdio.h>
@@ -22,24 +23,30 @@
 
 // Max size of a segment
 #define MAX_BUFSIZE 1024
+// How long the admin listener waits for a scraper to send its request or to read the response.
+#define ADMIN_TIMEOUT_MS 1000
 
 TCPServer* TCPServer::singleton = nullptr;
 
 TCPServer::TCPServer(const std::string& ip_addr, short port, int backlog)
-    :running(true), handler_set(false)
+    :running(true), handler_set(false), coalesce_handler(false), cacheable_handler(false),
+     batcher(nullptr), cache(nullptr),
+     compression_enabled(false), compression_threshold(0), tracer(nullptr),
+     shm_enabled(false), parallel_mode(false), shm_max_channels(0), admin_listener(-1)
 {
-    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(!parse_address(ip_addr, port, addr)) {
+        throw TCPServerError("Invalid server address.");
+    }
+
+    listener = socket(addr.family, SOCK_STREAM, 0);
     if(listener < 0) {
         throw TCPServerError("Listening socket creation failed.");
     }
 
-    addr.sin_family = AF_INET;
-    if(inet_aton(ip_addr.c_str(), &(addr.sin_addr)) == 0) {
-        throw TCPServerError("Invalid server IP address.");
-    }
-    addr.sin_port = htons(port);
+    // removes the socket file left by the previous run.
+    remove_socket_file(addr);
 
-    if(bind(listener, (const struct sockaddr*) &addr, sizeof(addr)) < 0) {
+    if(bind(listener, addr.sockaddr(), addr.length) < 0) {
         throw TCPServerError("Binding the socket with address failed.");
     }
     if(listen(listener, backlog) < 0) {
@@ -49,14 +56,13 @@ TCPServer::TCPServer(const std::string& ip_addr, short port, int backlog)
 
     signal(SIGINT, signal_handler);
 
-    std::ostringstream oss;
-    oss << ip_addr << ":" << port;
-
     info.ip_address = ip_addr;
     info.port = port;
-    info.endpoint = oss.str();
+    info.endpoint = format_address(ip_addr, port, addr);
 
     pool = new ThreadPool();
+    router = new Router();
+    flight = new SingleFlight();
 }
 
 TCPServer::~TCPServer()
@@ -64,29 +70,51 @@ TCPServer::~TCPServer()
     if(running)
         stop();
 
-    for(int i = 0; i < clients.size(); i++)
+    if(admin.joinable())
+        admin.join();
+
+    // running is false by now, so no offer adds a worker after the list is taken.
+    // the workers take the lock to mark themselves finished, so they are joined without it.
+    std::list<ShmWorker> workers;
+    {
+        std::unique_lock<std::mutex> lock(shm_mtx);
+        workers.swap(shm_workers);
+    }
+    for(auto& worker : workers)
+        worker.channel->close();
+    for(auto& worker : workers)
+        worker.thread.join();
+
+    for(size_t i = 0; i < clients.size(); i++)
         close(clients[i].clientfd);
     
     if(pool->busy_threads() > 0)
         std::cout << "Waiting for connections to close..." << std::endl;
 
     delete pool;
+    delete batcher;
+    delete router;
+    delete cache;
+    delete flight;
+    delete tracer;
+
+    remove_socket_file(addr);
 
     std::cout << "\n|=============================|\n"
                 << "| Server is terminated.       |"
               << "\n|=============================|\n";
 }
 
-void TCPServer::signal_handler(int signum)
+void TCPServer::signal_handler(int)
 {
     singleton->stop();
 }
 
 void TCPServer::print_info()
 {
-    std::string dynamic_line = "| Server IPv4 listening address: " +
+    std::string dynamic_line = "| Server listening address: " +
                                 info.endpoint +
-                                std::string(19 - info.endpoint.size(), ' ') +
+                                std::string(std::max(24 - (int) info.endpoint.size(), 0), ' ') +
                                 "|\n";
 
     std::cout << "|===================================================|\n"
@@ -104,12 +132,18 @@ void TCPServer::print_info()
 
 void TCPServer::run(bool parallel, int num_of_threads)
 {
-    if(!handler_set) {
-        throw TCPServerError("Server can't be started: request handler isn't set.");
+    if(!handler_set && router->empty()) {
+        throw TCPServerError("Server can't be started: neither request handler nor routes are set.");
     }
     system("clear");
     print_info();
 
+    // all the threads that handle the requests may wait for the batch.
+    if(batcher)
+        batcher->set_max_submitters(parallel ? num_of_threads : 1);
+
+    parallel_mode = parallel;
+
     if(parallel)
         parallel_run(num_of_threads);
     else
@@ -132,7 +166,16 @@ void TCPServer::stop()
     }
 
     running = false;
+
+    // the signal may be delivered to any thread, shutdown() wakes up accept() blocked in another one.
+    shutdown(listener, SHUT_RDWR);
     close(listener);   
+
+    if(admin_listener >= 0) {
+        shutdown(admin_listener, SHUT_RDWR);
+        close(admin_listener);
+        admin_listener = -1;
+    }
 }
 
 void TCPServer::sequential_run()
@@ -159,26 +202,25 @@ void TCPServer::sequential_run()
         }
 
         if(FD_ISSET(listener, &readfds)) {
-            struct sockaddr_in client_addr;
-            socklen_t client_addr_len = sizeof(client_addr);
-            int client = accept(listener, (struct sockaddr*) &client_addr, &client_addr_len);
-
-            std::string client_ip = std::string(inet_ntoa(client_addr.sin_addr));
-            unsigned short client_port = ntohs(client_addr.sin_port);
-            clients.push_back({client, client_ip, client_port});
-
-            std::cout << "Client " << client_ip << ":" << client_port << " connected to the server.\n";
+            ClientInfo client = accept_client();
+            if(client.clientfd >= 0)
+                clients.push_back(client);
         }
 
-        for(int i = 0; i < clients.size(); i++) {
+        for(int i = 0; i < (int) clients.size(); i++) {
             if(FD_ISSET(clients[i].clientfd, &readfds)) {
                 try {
                     handle_request(clients[i]);
+                    if(clients[i].handed_over) {
+                        clients.erase(clients.begin() + i);
+                        i--;
+                    }
                 }
                 catch(const TCPServerError& err) {
                     std::cerr << err.what() << std::endl;
                     close(clients[i].clientfd);
                     clients.erase(clients.begin() + i); 
+                    metrics.active_connections--;
                 }
             }
         }
@@ -191,47 +233,89 @@ void TCPServer::parallel_run(int num_of_threads)
     pool->start(num_of_threads);
 
     while(running) {
-        struct sockaddr_in client_addr;
-        socklen_t client_addr_len = sizeof(client_addr);
-        int client = accept(listener, (struct sockaddr*) &client_addr, &client_addr_len);
-        if(client < 0)
+        ClientInfo accepted = accept_client();
+        if(accepted.clientfd < 0)
             break;
-
-        std::string client_ip = std::string(inet_ntoa(client_addr.sin_addr));
-        unsigned short client_port = ntohs(client_addr.sin_port);
-        std::cout << "Client " << client_ip << ":" << client_port << " connected to the server.\n";
+        int client = accepted.clientfd;
+        accepted.queued = now_ns();
 
         // each thread has only one client descriptor, so
         // each thread can maintain only one connection and needs to
         // realese the obtained resources by itself.
         auto task = [=] {
+            ClientInfo info = accepted;
+            info.dequeued = now_ns();
             fd_set readfd;
 
-            FD_SET(client, &readfd);
-
             while(true) {
+                FD_ZERO(&readfd);
+                FD_SET(client, &readfd);
                 if(select(client + 1, &readfd, NULL, NULL, NULL) < 0) {
                     break;
                 }
 
                 try {
-                    handle_request({client, client_ip, client_port});
+                    handle_request(info);
+                    if(info.handed_over)
+                        return;
                 }
                 catch(const TCPServerError& err) {
                     std::cerr << err.what() << std::endl;
-                    close(client);
+                    break;
                 }
             }
 
+            // closes the descriptor only once, otherwise it could close
+            // the descriptor reused by another connection.
             close(client);
+            metrics.active_connections--;
         };
         pool->execute_task(task);
     }
 }
 
+TCPServer::ClientInfo TCPServer::accept_client()
+{
+    struct sockaddr_storage client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+
+    ClientInfo client;
+    client.clientfd = accept(listener, (struct sockaddr*) &client_addr, &client_addr_len);
+    if(client.clientfd < 0)
+        return client;
+
+    if(!addr.is_unix())
+        set_nodelay(client.clientfd);
+
+    peer_address(client_addr, client.ip_addr, client.port);
+    client.accepted = now_ns();
+    metrics.accepted++;
+    metrics.active_connections++;
+
+    std::cout << "Client " << client.ip_addr << ":" << client.port << " connected to the server.\n";
+
+    return client;
+}
+
 std::string TCPServer::form_request(const ClientInfo& client)
 {
     std::string result = "";
+
+    if(client.codec != Codec::None) {
+        int status = receive_message(client.clientfd, result, compression);
+        if(status < 0) {
+            throw TCPServerError("Something went wrong upon forming the request.");
+        }
+        else if(status == 0) {
+            std::ostringstream oss;
+            oss << client.ip_addr << ":" << client.port;
+
+            throw TCPServerError("Client " + oss.str() + " closed the connection.");
+        }
+
+        return result;
+    }
+
     char buffer[MAX_BUFSIZE];
     
     while(true) {
@@ -263,11 +347,19 @@ std::string TCPServer::form_request(const ClientInfo& client)
 
 void TCPServer::send_response(const ClientInfo& client, const std::string& data)
 {
+    if(client.codec != Codec::None) {
+        if(!send_message(client.clientfd, data.data(), data.size(),
+                         client.codec, compression_threshold, compression)) {
+            throw TCPServerError("Not the entire response was sent. Sending response failed.");
+        }
+        return;
+    }
+
     std::vector<std::string> segments = chunks(data, MAX_BUFSIZE);
     int total = 0;
 
     int bytes = 0;
-    for(int i = 0; i < segments.size(); i++) {
+    for(size_t i = 0; i < segments.size(); i++) {
         bytes += write(client.clientfd, segments[i].c_str(), segments[i].size());
         total += segments[i].size();
     }
@@ -279,17 +371,628 @@ void TCPServer::send_response(const ClientInfo& client, const std::string& data)
     }
 }
 
-void TCPServer::handle_request(const ClientInfo& client)
+void TCPServer::send_file_response(const ClientInfo& client, FileResponse& file)
+{
+    bool sent;
+    if(client.codec != Codec::None) {
+        // compression needs the bytes in user space anyway.
+        std::string data;
+        sent = read_file(file, data) &&
+               send_message(client.clientfd, data.data(), data.size(),
+                            client.codec, compression_threshold, compression);
+    }
+    else {
+        sent = send_file(client.clientfd, file) && write(client.clientfd, "\n\n", 2) == 2;
+    }
+
+    release_file(file);
+    if(!sent) {
+        throw TCPServerError("Not the entire response was sent. Sending response failed.");
+    }
+}
+
+void TCPServer::send_framed(const ClientInfo& client, const std::string& framed)
+{
+    // the negotiated codec has its own framing, the trailer isn't needed.
+    if(client.codec != Codec::None) {
+        if(!send_message(client.clientfd, framed.data(), framed.size() - 2,
+                         client.codec, compression_threshold, compression)) {
+            throw TCPServerError("Not the entire response was sent. Sending response failed.");
+        }
+        return;
+    }
+
+    size_t sent = 0;
+    while(sent < framed.size()) {
+        size_t size = std::min(framed.size() - sent, (size_t) MAX_BUFSIZE);
+        int bytes = write(client.clientfd, framed.data() + sent, size);
+        if(bytes <= 0) {
+            throw TCPServerError("Not the entire response was sent. Sending response failed.");
+        }
+        sent += bytes;
+    }
+}
+
+void TCPServer::handle_request(ClientInfo& client)
 {
+    TraceRecord trace = {};
+    trace.clientfd = client.clientfd;
+    if(client.first_request) {
+        trace.accept = client.accepted;
+        trace.queued = client.queued;
+        trace.dequeued = client.dequeued;
+        client.first_request = false;
+    }
+    // the request is handled once the descriptor is readable, so the first byte is already there.
+    trace.first_byte = now_ns();
+
     std::string data = form_request(client);
+    trace.full_frame = now_ns();
+    trace.request_bytes = data.size();
+
+    // only the exact control requests are intercepted, the rest go to the handler even if they start with CONTROL_BYTE.
+    size_t shm_capacity;
+    bool shm_spin;
+    if(is_compression_offer(data) || parse_shm_offer(data, shm_capacity, shm_spin)) {
+        handle_control(client, data);
+        return;
+    }
+
     std::cout << "Request from " << client.ip_addr << ":" << client.port << ": " << data << std::endl;
 
-    std::string response = handler(data);
-    send_response(client, response);
+    trace.handler_start = now_ns();
+
+    ResponseCache::Response framed;
+    std::string response;
+    FileResponse file;
+    process_request(data, framed, response, file);
+
+    trace.handler_end = now_ns();
+    trace.response_bytes = file.fd >= 0 ? file.length : framed ? framed->size() - 2 : response.size();
+
+    if(file.fd >= 0)
+        send_file_response(client, file);
+    else if(framed)
+        send_framed(client, *framed);
+    else
+        send_response(client, response);
+
+    trace.last_byte = now_ns();
+
+    record_request(trace);
+}
+
+void TCPServer::process_request(const std::string& data,
+                                ResponseCache::Response& framed,
+                                std::string& response,
+                                FileResponse& file)
+{
+    int route = router->match(data);
+
+    // files bypass the cache and coalescing, they aren't read into memory at all.
+    if(route < 0 && file_handler) {
+        file = file_handler(data);
+        if(file.fd < 0)
+            response = file.text;
+        return;
+    }
+    bool coalesce = route >= 0 ? router->coalesce(route) : coalesce_handler;
+    // only the handlers marked as idempotent are cached.
+    bool cached = cache && (route >= 0 ? router->cacheable(route) : cacheable_handler);
+
+    if(cached || coalesce) {
+        framed = cached ? cache->lookup(data) : nullptr;
+        if(!framed) {
+            auto produce = [&] {
+                ResponseCache::Response result =
+                    std::make_shared<const std::string>(call_handler(route, data) + "\n\n");
+                if(cached)
+                    cache->insert(data, result);
+                return result;
+            };
+
+            framed = coalesce ? flight->run(data, produce) : produce();
+        }
+    }
+    else {
+        response = call_handler(route, data);
+    }
+}
+
+void TCPServer::record_request(TraceRecord& trace)
+{
+    metrics.requests++;
+    metrics.bytes_in += trace.request_bytes;
+    metrics.bytes_out += trace.response_bytes;
+
+    metrics.handler_time.record(trace.handler_end - trace.handler_start);
+    metrics.io_time.record((trace.full_frame - trace.first_byte) + (trace.last_byte - trace.handler_end));
+    metrics.request_time.record(trace.last_byte - trace.first_byte);
+
+    if(tracer && tracer->sample())
+        tracer->push(trace);
+}
+
+void TCPServer::handle_control(ClientInfo& client, const std::string& data)
+{
+    if(is_compression_offer(data)) {
+        Codec codec = compression_enabled ? choose_codec(data) : Codec::None;
+
+        // the answer still uses the old framing, the codec is applied starting from the next request.
+        send_response(client, compression_answer(codec));
+        client.codec = codec;
+
+        std::cout << "Client " << client.ip_addr << ":" << client.port
+                  << " negotiated compression: " << codec_name(codec) << std::endl;
+        return;
+    }
+
+    size_t capacity;
+    bool spin;
+    if(parse_shm_offer(data, capacity, spin)) {
+        // the segment is passed to the client as a descriptor, which only Unix domain sockets can carry.
+        // in sequential mode a channel thread would run the handler next to the main loop, so the offer is declined.
+        bool local = shm_enabled && parallel_mode && addr.is_unix();
+
+        // the worker is started under the lock, so the concurrent offers can't exceed the limit
+        // and the destructor, which takes the list under the same lock, joins every started worker.
+        // the worker waits until the answer is sent, so only this thread writes to the socket meanwhile.
+        std::shared_ptr<ShmChannel> channel;
+        std::list<ShmWorker>::iterator worker;
+        {
+            std::unique_lock<std::mutex> lock(shm_mtx);
+            reap_shm_workers();
+
+            if(local && running && shm_workers.size() < shm_max_channels) {
+                try {
+                    channel = std::make_shared<ShmChannel>(capacity, spin);
+                }
+                catch(const ShmChannel::ShmError& err) {
+                    std::cerr << err.what() << std::endl;
+                }
+            }
+
+            if(channel) {
+                // the socket is kept open only to find out when the client is gone, the worker closes it.
+                channel->set_peer(client.clientfd);
+                client.handed_over = true;
+
+                worker = shm_workers.insert(shm_workers.end(), ShmWorker());
+                worker->channel = channel;
+                worker->thread = std::thread([this, worker, client] { serve_shm(*worker, client); });
+            }
+        }
+
+        if(!channel) {
+            if(!send_shm_segment(client.clientfd, -1)) {
+                throw TCPServerError("Answer to the shared memory offer can't be sent.");
+            }
+            send_response(client, shm_answer(false));
+            return;
+        }
+
+        // the connection belongs to the worker now, closing the channel makes it release the connection.
+        bool sent = true;
+        try {
+            if(!send_shm_segment(client.clientfd, channel->get_fd())) {
+                throw TCPServerError("Shared memory segment can't be passed to the client.");
+            }
+            send_response(client, shm_answer(true));
+        }
+        catch(const TCPServerError& err) {
+            std::cerr << err.what() << std::endl;
+            channel->close();
+            sent = false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(shm_mtx);
+            worker->answered = true;
+        }
+        shm_answered.notify_all();
+
+        if(!sent) {
+            return;
+        }
+
+        std::cout << "Client " << client.ip_addr << ":" << client.port
+                  << " switched to shared memory channel of " << capacity << " bytes" << std::endl;
+    }
+}
+
+void TCPServer::serve_shm(ShmWorker& worker, ClientInfo client)
+{
+    std::shared_ptr<ShmChannel> channel = worker.channel;
+    {
+        std::unique_lock<std::mutex> lock(shm_mtx);
+        shm_answered.wait(lock, [&worker] { return worker.answered; });
+    }
+
+    // requests aren't logged here, printing would take longer than the round trip itself.
+    std::string data;
+    while(running && channel->receive(data) > 0) {
+        TraceRecord trace = {};
+        // the channel is opened by a request on the socket, so no request here is the first one.
+        trace.clientfd = client.clientfd;
+        trace.first_byte = trace.full_frame = trace.handler_start = now_ns();
+        trace.request_bytes = data.size();
+
+        ResponseCache::Response framed;
+        std::string response;
+        FileResponse file;
+        // the failed request drops only this connection, like on the sockets.
+        try {
+            process_request(data, framed, response, file);
+        }
+        catch(const TCPServerError& err) {
+            std::cerr << err.what() << std::endl;
+            break;
+        }
+
+        // the channel needs the bytes themselves.
+        if(file.fd >= 0) {
+            bool read = read_file(file, response);
+            release_file(file);
+            if(!read)
+                break;
+        }
+        trace.handler_end = now_ns();
+
+        bool sent = framed ? channel->send(framed->data(), framed->size() - 2)
+                           : channel->send(response.data(), response.size());
+        if(!sent)
+            break;
+
+        trace.last_byte = now_ns();
+        trace.response_bytes = framed ? framed->size() - 2 : response.size();
+        record_request(trace);
+    }
+
+    channel->close();
+    close(client.clientfd);
+    metrics.active_connections--;
+
+    std::cout << "Client " << client.ip_addr << ":" << client.port << " closed the shared memory channel.\n";
+
+    std::unique_lock<std::mutex> lock(shm_mtx);
+    worker.finished = true;
 }
 
-void TCPServer::set_handler(std::function<std::string(const std::string&)> _handler)
+void TCPServer::reap_shm_workers()
+{
+    for(auto it = shm_workers.begin(); it != shm_workers.end();) {
+        if(it->finished) {
+            it->thread.join();
+            it = shm_workers.erase(it);
+        }
+        else
+            it++;
+    }
+}
+
+std::string TCPServer::call_handler(int route, const std::string& data)
+{
+    if(route >= 0)
+        return router->call(route, data);
+
+    // requests that don't match any route go to the handler.
+    if(!handler_set)
+        return "Unknown command.";
+
+    if(batcher) {
+        // the error is raised in every request of the batch, so it can't stop the server.
+        try {
+            return batcher->submit(data);
+        }
+        catch(const std::exception& err) {
+            std::string prefix = "Batch processing failed: ";
+            throw TCPServerError(prefix + err.what());
+        }
+    }
+
+    return handler(data);
+}
+
+void TCPServer::set_handler(std::function<std::string(const std::string&)> _handler,
+                            bool coalesce,
+                            bool cacheable)
 {
     handler_set = true;
     handler = _handler;
+    file_handler = nullptr;
+    coalesce_handler = coalesce;
+    cacheable_handler = cacheable;
+
+    delete batcher;
+    batcher = nullptr;
+}
+
+void TCPServer::set_batch_handler(Batcher::BatchHandler batch_handler,
+                                  size_t max_batch_size,
+                                  std::chrono::microseconds window,
+                                  bool coalesce,
+                                  bool cacheable)
+{
+    handler_set = true;
+    file_handler = nullptr;
+    coalesce_handler = coalesce;
+    cacheable_handler = cacheable;
+
+    delete batcher;
+    batcher = new Batcher(batch_handler, max_batch_size, window);
+}
+
+void TCPServer::set_file_handler(FileHandler _file_handler)
+{
+    handler_set = true;
+    file_handler = _file_handler;
+    coalesce_handler = false;
+    cacheable_handler = false;
+
+    delete batcher;
+    batcher = nullptr;
+}
+
+Batcher::Stats TCPServer::batch_stats()
+{
+    if(!batcher)
+        return Batcher::Stats();
+
+    return batcher->stats();
+}
+
+void TCPServer::set_routing(Router::Mode mode, char delimiter)
+{
+    if(!router->empty()) {
+        throw TCPServerError("Routing mode can't be changed after routes are added.");
+    }
+
+    delete router;
+    router = new Router(mode, delimiter);
+}
+
+void TCPServer::add_route(const std::string& command,
+                          std::function<std::string(const std::string&)> route_handler,
+                          bool coalesce,
+                          bool cacheable)
+{
+    try {
+        router->add_route(command, route_handler, coalesce, cacheable);
+    }
+    catch(const Router::RouterError& err) {
+        std::string prefix = "Adding route failed: ";
+        throw TCPServerError(prefix + err.what());
+    }
+}
+
+std::vector<Router::RouteStats> TCPServer::route_stats()
+{ return router->stats(); }
+
+void TCPServer::enable_cache(size_t max_bytes, std::chrono::milliseconds ttl, int num_of_shards)
+{
+    delete cache;
+    cache = new ResponseCache(max_bytes, ttl, num_of_shards);
+}
+
+ResponseCache::Stats TCPServer::cache_stats()
+{
+    if(!cache)
+        return ResponseCache::Stats();
+
+    return cache->stats();
+}
+
+SingleFlight::Stats TCPServer::coalescing_stats()
+{ return flight->stats(); }
+
+void TCPServer::enable_compression(size_t threshold)
+{
+    compression_enabled = true;
+    compression_threshold = threshold;
+}
+
+CompressionStats TCPServer::compression_stats()
+{ return compression.snapshot(); }
+
+void TCPServer::enable_shared_memory(size_t max_channels)
+{
+    shm_enabled = true;
+    shm_max_channels = max_channels;
+}
+
+void TCPServer::enable_admin(const std::string& ip_addr, short port)
+{
+    if(admin_listener >= 0) {
+        throw TCPServerError("Admin listener is already enabled.");
+    }
+
+    Address admin_addr;
+    if(!parse_address(ip_addr, port, admin_addr)) {
+        throw TCPServerError("Invalid admin address.");
+    }
+
+    // the socket becomes the admin listener only when it listens, so a failed call can be retried.
+    int fd = socket(admin_addr.family, SOCK_STREAM, 0);
+    if(fd < 0) {
+        throw TCPServerError("Admin listening socket creation failed.");
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    remove_socket_file(admin_addr);
+
+    if(bind(fd, admin_addr.sockaddr(), admin_addr.length) < 0) {
+        close(fd);
+        throw TCPServerError("Binding the admin socket with address failed.");
+    }
+    if(listen(fd, 16) < 0) {
+        close(fd);
+        throw TCPServerError("Server can't listen on the admin socket.");
+    }
+
+    admin_listener = fd;
+    admin = std::thread([this] { serve_admin(); });
+}
+
+void TCPServer::serve_admin()
+{
+    int admin_fd = admin_listener;
+    while(true) {
+        int conn = accept(admin_fd, NULL, NULL);
+        if(conn < 0)
+            return;
+
+        // a connection that sends nothing can't block the only admin thread.
+        struct timeval timeout = {ADMIN_TIMEOUT_MS / 1000, (ADMIN_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // the request line fits into one segment, the rest of the request isn't needed.
+        char buffer[MAX_BUFSIZE];
+        int bytes = read(conn, buffer, MAX_BUFSIZE);
+        std::string request(buffer, bytes > 0 ? bytes : 0);
+
+        std::string body = request.compare(0, 12, "GET /traces ") == 0 ? render_traces() : render_metrics();
+
+        std::ostringstream oss;
+        oss << "HTTP/1.0 200 OK\r\n"
+            << "Content-Type: text/plain; version=0.0.4\r\n"
+            << "Content-Length: " << body.size() << "\r\n"
+            << "Connection: close\r\n\r\n"
+            << body;
+        std::string response = oss.str();
+
+        size_t sent = 0;
+        while(sent < response.size()) {
+            int written = write(conn, response.data() + sent, response.size() - sent);
+            if(written <= 0)
+                break;
+            sent += written;
+        }
+
+        close(conn);
+    }
+}
+
+std::string TCPServer::render_metrics()
+{
+    std::ostringstream oss;
+
+    render_metric(oss, "tcpserver_accepted_connections_total", "counter",
+                  "Accepted connections.", metrics.accepted.load());
+    render_metric(oss, "tcpserver_active_connections", "gauge",
+                  "Open connections.", metrics.active_connections.load());
+    render_metric(oss, "tcpserver_requests_total", "counter",
+                  "Handled requests.", metrics.requests.load());
+    render_metric(oss, "tcpserver_received_bytes_total", "counter",
+                  "Request payload bytes.", metrics.bytes_in.load());
+    render_metric(oss, "tcpserver_sent_bytes_total", "counter",
+                  "Response payload bytes.", metrics.bytes_out.load());
+    render_metric(oss, "tcpserver_pool_queue_depth", "gauge",
+                  "Connections waiting for a pool thread.", pool->pending_tasks());
+    render_metric(oss, "tcpserver_pool_busy_threads", "gauge",
+                  "Pool threads serving connections.", pool->busy_threads());
+
+    metrics.handler_time.render(oss, "tcpserver_handler_seconds",
+                                "Time spent forming the response.");
+    metrics.io_time.render(oss, "tcpserver_io_seconds",
+                           "Time spent reading the request and writing the response.");
+    metrics.request_time.render(oss, "tcpserver_request_seconds",
+                                "Time from the first byte of the request to the last byte of the response.");
+
+    if(cache) {
+        ResponseCache::Stats cached = cache->stats();
+        render_metric(oss, "tcpserver_cache_hits_total", "counter", "Response cache hits.", cached.hits);
+        render_metric(oss, "tcpserver_cache_misses_total", "counter", "Response cache misses.", cached.misses);
+        render_metric(oss, "tcpserver_cache_bytes", "gauge", "Response cache size.", cached.bytes);
+    }
+
+    SingleFlight::Stats coalesced = flight->stats();
+    render_metric(oss, "tcpserver_coalesced_requests_total", "counter",
+                  "Requests that reused a response in flight.", coalesced.coalesced);
+
+    if(batcher) {
+        Batcher::Stats batches = batcher->stats();
+        render_metric(oss, "tcpserver_batches_total", "counter", "Processed batches.", batches.batches);
+        render_metric(oss, "tcpserver_batched_requests_total", "counter",
+                      "Requests processed in batches.", batches.requests);
+    }
+
+    CompressionStats compressed = compression.snapshot();
+    render_metric(oss, "tcpserver_compression_sent_raw_bytes_total", "counter",
+                  "Sent bytes before compression.", compressed.sent_raw_bytes);
+    render_metric(oss, "tcpserver_compression_sent_wire_bytes_total", "counter",
+                  "Sent bytes after compression.", compressed.sent_wire_bytes);
+    render_metric(oss, "tcpserver_compression_received_raw_bytes_total", "counter",
+                  "Received bytes after decompression.", compressed.received_raw_bytes);
+    render_metric(oss, "tcpserver_compression_received_wire_bytes_total", "counter",
+                  "Received bytes before decompression.", compressed.received_wire_bytes);
+
+    // the CPU time tells together with the byte counts whether compression pays off.
+    oss << "# HELP tcpserver_compression_compress_seconds_total Time spent compressing.\n"
+        << "# TYPE tcpserver_compression_compress_seconds_total counter\n"
+        << "tcpserver_compression_compress_seconds_total " << compressed.compress_ns / 1e9 << "\n";
+    oss << "# HELP tcpserver_compression_decompress_seconds_total Time spent decompressing.\n"
+        << "# TYPE tcpserver_compression_decompress_seconds_total counter\n"
+        << "tcpserver_compression_decompress_seconds_total " << compressed.decompress_ns / 1e9 << "\n";
+
+    std::vector<Router::RouteStats> routes = router->stats();
+    if(!routes.empty()) {
+        oss << "# HELP tcpserver_route_requests_total Requests per route.\n"
+            << "# TYPE tcpserver_route_requests_total counter\n";
+        for(auto& route : routes)
+            oss << "tcpserver_route_requests_total{route=\"" << route.command << "\"} " << route.count << "\n";
+
+        oss << "# HELP tcpserver_route_handler_seconds_total Handler time per route.\n"
+            << "# TYPE tcpserver_route_handler_seconds_total counter\n";
+        for(auto& route : routes)
+            oss << "tcpserver_route_handler_seconds_total{route=\"" << route.command << "\"} "
+                << route.total_ns / 1e9 << "\n";
+    }
+
+    return oss.str();
+}
+
+std::string TCPServer::render_traces()
+{
+    std::ostringstream oss;
+    oss << "# id fd accept_to_first_byte_us pool_queue_us read_us handler_us write_us total_us request_bytes response_bytes\n";
+    oss << "# accept_to_first_byte_us and pool_queue_us are shown only in the first request of a connection, - otherwise\n";
+
+    auto us = [](uint64_t from, uint64_t to) { return (to - from) / 1000.0; };
+    auto span = [&](uint64_t from, uint64_t to) {
+        std::ostringstream field;
+        if(from == 0 || to == 0)
+            field << "-";
+        else
+            field << us(from, to);
+        return field.str();
+    };
+    for(auto& trace : traces()) {
+        oss << trace.id << " " << trace.clientfd << " "
+            << span(trace.accept, trace.first_byte) << " "
+            << span(trace.queued, trace.dequeued) << " "
+            << us(trace.first_byte, trace.full_frame) << " "
+            << us(trace.handler_start, trace.handler_end) << " "
+            << us(trace.handler_end, trace.last_byte) << " "
+            << us(trace.first_byte, trace.last_byte) << " "
+            << trace.request_bytes << " " << trace.response_bytes << "\n";
+    }
+
+    return oss.str();
+}
+
+void TCPServer::enable_tracing(int sample_every, size_t capacity)
+{
+    delete tracer;
+    tracer = new TraceRing(capacity, sample_every);
+}
+
+std::vector<TraceRecord> TCPServer::traces()
+{
+    if(!tracer)
+        return std::vector<TraceRecord>();
+
+    return tracer->snapshot();
 }
\ No newline at end of file
@@ -4,9 +4,20 @@
 #include <arpa/inet.h>
 
 #include <vector>
+#include <list>
 #include <string>
+#include <atomic>
 
 #include "../pool/thread_pool.hpp"
+#include "../cache/response_cache.hpp"
+#include "../flight/single_flight.hpp"
+#include "../router/router.hpp"
+#include "../batch/batcher.hpp"
+#include "../codec/codec.hpp"
+#include "../stats/stats.hpp"
+#include "../transport/address.hpp"
+#include "../shm/shm_channel.hpp"
+#include "../file/file_response.hpp"
 
 /*
     Simple TCP server.
@@ -22,16 +33,30 @@ class TCPServer {
     TCPServer(const std::string&, short port, int);
 
     int listener;
-    struct sockaddr_in addr;
+    Address addr;
 
     struct ClientInfo {
         int clientfd;
         std::string ip_addr;
         unsigned short port;
+
+        // negotiated codec, Codec::None means the plain framing.
+        Codec codec = Codec::None;
+
+        uint64_t accepted = 0;
+        // when the connection was put into the pool queue and taken by a pool thread.
+        uint64_t queued = 0;
+        uint64_t dequeued = 0;
+        // the connection-level timestamps go only to the trace of the first request.
+        bool first_request = true;
+
+        // the connection was passed to another thread, which closes it.
+        bool handed_over = false;
     };
     std::vector<ClientInfo> clients;
+    ClientInfo accept_client();
 
-    bool running;
+    std::atomic<bool> running;
     void stop();
     
     ThreadPool * pool;
@@ -41,10 +66,57 @@ class TCPServer {
 
     std::string form_request(const ClientInfo&);
     void send_response(const ClientInfo&, const std::string&);
+    void send_framed(const ClientInfo&, const std::string&);
+    void send_file_response(const ClientInfo&, FileResponse&);
 
     bool handler_set;
+    bool coalesce_handler;
+    bool cacheable_handler;
     std::function<std::string(const std::string&)> handler;
-    void handle_request(const ClientInfo&);
+    FileHandler file_handler;
+    void handle_request(ClientInfo&);
+    void handle_control(ClientInfo&, const std::string&);
+    void process_request(const std::string&, ResponseCache::Response&, std::string&, FileResponse&);
+
+    Batcher* batcher;
+
+    Router* router;
+    std::string call_handler(int, const std::string&);
+
+    ResponseCache* cache;
+    SingleFlight* flight;
+
+    bool compression_enabled;
+    size_t compression_threshold;
+    CompressionCounters compression;
+
+    ServerMetrics metrics;
+    TraceRing* tracer;
+    void record_request(TraceRecord&);
+
+    // a shared-memory connection and the thread serving it, joined once it's finished.
+    struct ShmWorker {
+        std::shared_ptr<ShmChannel> channel;
+        std::thread thread;
+        // set once the answer to the offer is sent, the worker doesn't touch the connection before.
+        bool answered = false;
+        bool finished = false;
+    };
+    bool shm_enabled;
+    // the channels have threads of their own, so they are served only in parallel mode.
+    bool parallel_mode;
+    size_t shm_max_channels;
+    std::mutex shm_mtx;
+    std::condition_variable shm_answered;
+    std::list<ShmWorker> shm_workers;
+    void serve_shm(ShmWorker&, ClientInfo);
+    void reap_shm_workers();
+
+    int admin_listener;
+    std::thread admin;
+    void serve_admin();
+    std::string render_metrics();
+    std::string render_traces();
 
     void print_info();
 public:
@@ -86,7 +158,39 @@ public:
 
     void run(bool, int num_of_threads = 1);
 
-    void set_handler(std::function<std::string(const std::string&)>);
+    void set_handler(std::function<std::string(const std::string&)>, bool coalesce = false, bool cacheable = false);
+
+    void set_batch_handler(Batcher::BatchHandler,
+                           size_t max_batch_size = 64,
+                           std::chrono::microseconds window = std::chrono::microseconds(200),
+                           bool coalesce = false,
+                           bool cacheable = false);
+    Batcher::Stats batch_stats();
+
+    void set_file_handler(FileHandler);
+
+    void set_routing(Router::Mode, char delimiter = ' ');
+    void add_route(const std::string&,
+                   std::function<std::string(const std::string&)>,
+                   bool coalesce = false,
+                   bool cacheable = false);
+    std::vector<Router::RouteStats> route_stats();
+
+    void enable_cache(size_t max_bytes,
+                      std::chrono::milliseconds ttl = std::chrono::milliseconds(0),
+                      int num_of_shards = 16);
+    ResponseCache::Stats cache_stats();
+
+    SingleFlight::Stats coalescing_stats();
+
+    void enable_compression(size_t threshold = 512);
+    CompressionStats compression_stats();
+
+    void enable_shared_memory(size_t max_channels = 64);
+
+    void enable_admin(const std::string& ip_addr, short port);
+    void enable_tracing(int sample_every = 100, size_t capacity = 4096);
+    std::vector<TraceRecord> traces();
 };
 
 
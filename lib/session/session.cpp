@@ -19,25 +19,22 @@
 #define MAX_BUFSIZE 1024
 
 Session::Session(const std::string& service_addr, short service_port)
+    :codec(Codec::None), compression_threshold(0), shm(nullptr)
 {
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    if(sock < 0) {
-        throw SessionError("Session creation failed: socket isn't created.");
+    if(!parse_address(service_addr, service_port, addr)) {
+        throw SessionError("Invalid service address.");
     }
 
-    addr.sin_family = AF_INET;
-    if(inet_aton(service_addr.c_str(), &(addr.sin_addr)) < 0) {
-        throw SessionError("Invalid service IP address.");
+    sock = socket(addr.family, SOCK_STREAM, 0);
+    if(sock < 0) {
+        throw SessionError("Session creation failed: socket isn't created.");
     }
-    addr.sin_port = htons(service_port);
-
-
-    std::ostringstream oss;
-    oss << service_addr << ":" << service_port;
+    if(!addr.is_unix())
+        set_nodelay(sock);
 
     service_info.ip_address = service_addr;
     service_info.port = service_port;
-    service_info.endpoint = oss.str();
+    service_info.endpoint = format_address(service_addr, service_port, addr);
 }
 
 Session::~Session()
@@ -45,13 +42,16 @@ Session::~Session()
 
 void Session::connect_to_service()
 {
-    if(connect(sock, (const sockaddr*) &addr, sizeof(addr)) < 0) {
+    if(connect(sock, addr.sockaddr(), addr.length) < 0) {
         throw SessionError("Connecting to the service failed.");
     }
 }
 
 void Session::terminate()
 {
+    delete shm;
+    shm = nullptr;
+
     close(sock);
 
     std::cout << "Session terminated.\n";
@@ -59,11 +59,25 @@ void Session::terminate()
 
 void Session::send_data(const std::string& data)
 {
+    if(shm) {
+        if(!shm->send(data.data(), data.size())) {
+            throw SessionError("Not the entire data was sent. Sending data failed.");
+        }
+        return;
+    }
+
+    if(codec != Codec::None) {
+        if(!send_message(sock, data.data(), data.size(), codec, compression_threshold, compression)) {
+            throw SessionError("Not the entire data was sent. Sending data failed.");
+        }
+        return;
+    }
+
     std::vector<std::string> segments = chunks(data, MAX_BUFSIZE);
     int total = 0;
 
     int bytes = 0;
-    for(int i = 0; i < segments.size(); i++) {
+    for(size_t i = 0; i < segments.size(); i++) {
         bytes += write(sock, segments[i].c_str(), segments[i].size());
     }
     
@@ -77,6 +91,26 @@ void Session::send_data(const std::string& data)
 std::string Session::receive_data()
 {
     std::string result = "";
+
+    if(shm) {
+        if(shm->receive(result) <= 0) {
+            throw SessionError("Server has closed the connection.");
+        }
+        return result;
+    }
+
+    if(codec != Codec::None) {
+        int status = receive_message(sock, result, compression);
+        if(status < 0) {
+            throw SessionError("Something went wrong upon getting response from the server.");
+        }
+        else if(status == 0) {
+            throw SessionError("Server has closed the connection.");
+        }
+
+        return result;
+    }
+
     char buffer[MAX_BUFSIZE];
     
     while(true) {
@@ -102,4 +136,69 @@ std::string Session::receive_data()
     }
 
     return result;
-}
\ No newline at end of file
+}
+
+Codec Session::enable_compression(size_t threshold)
+{
+    if(codec != Codec::None)
+        return codec;
+
+    send_data(compression_offer());
+
+    // the server that doesn't support compression answers something else,
+    // then the plain framing is kept.
+    Codec chosen;
+    if(!parse_compression_answer(receive_data(), chosen))
+        return Codec::None;
+
+    codec = chosen;
+    compression_threshold = threshold;
+
+    return codec;
+}
+
+bool Session::use_shared_memory(size_t capacity, bool spin)
+{
+    if(shm)
+        return true;
+
+    // the server that knows the offer sends the segment before the answer, even if it declines.
+    int segment;
+    std::string answer;
+    send_data(shm_offer(capacity, spin));
+    if(!receive_shm_segment(sock, segment)) {
+        throw SessionError("Shared memory segment wasn't received.");
+    }
+
+    try {
+        answer = receive_data();
+    }
+    catch(const SessionError& err) {
+        if(segment >= 0)
+            close(segment);
+        throw;
+    }
+
+    if(!parse_shm_answer(answer) || segment < 0) {
+        if(segment >= 0)
+            close(segment);
+        return false;
+    }
+
+    // the mapping stays valid after the descriptor is closed.
+    ShmChannel* channel;
+    try {
+        channel = new ShmChannel(segment);
+    }
+    catch(const ShmChannel::ShmError& err) {
+        close(segment);
+        std::string prefix = "Shared memory channel can't be mapped: ";
+        throw SessionError(prefix + err.what());
+    }
+    close(segment);
+
+    channel->set_peer(sock);
+    shm = channel;
+
+    return true;
+}
@@ -6,9 +6,20 @@
 
 #include <arpa/inet.h>
 
+#include "../codec/codec.hpp"
+#include "../transport/address.hpp"
+#include "../shm/shm_channel.hpp"
+
 class Session {
     int sock;
-    struct sockaddr_in addr;
+    Address addr;
+
+    // negotiated codec, Codec::None means the plain framing.
+    Codec codec;
+    size_t compression_threshold;
+    CompressionCounters compression;
+
+    ShmChannel* shm;
 
     void terminate();
 public:
@@ -44,6 +55,12 @@ public:
 
     void send_data(const std::string&);
     std::string receive_data();
+
+    bool use_shared_memory(size_t capacity = 1 << 20, bool spin = false);
+
+    Codec enable_compression(size_t threshold = 512);
+    CompressionStats compression_stats()
+    { return compression.snapshot(); }
 };
 
 
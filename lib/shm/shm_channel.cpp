@@ -0,0 +1,468 @@
+#include "shm_channel.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#include "../utils/utils.hpp"
+
+#define SHM_MAGIC 0x54435348
+#define REQUESTS 0
+#define RESPONSES 1
+
+#define MIN_RING_SIZE 4096
+#define MAX_RING_SIZE (1ULL << 30)
+// Default limit of a received message.
+#define MAX_MESSAGE_SIZE (256 * 1024 * 1024)
+
+// Iterations spent spinning before sleeping on the futex.
+#define SPIN_LIMIT 2000
+// How often a spinning side lets other threads run, so it doesn't starve the peer on a busy host.
+#define YIELD_INTERVAL 1024
+// How often a spinning side checks that the peer is still alive.
+#define PEER_CHECK_INTERVAL (1 << 20)
+
+static const bool single_cpu = std::thread::hardware_concurrency() <= 1;
+// How long a sleeping side waits before checking that the peer is still alive.
+#define SLEEP_TIMEOUT_NS 100000000
+
+struct alignas(64) ShmRing {
+    // written by the producer only.
+    alignas(64) std::atomic<uint64_t> head;
+    // written by the consumer only.
+    alignas(64) std::atomic<uint64_t> tail;
+
+    // futex words, bumped when a sleeping side is woken up.
+    alignas(64) std::atomic<uint32_t> data_seq;
+    std::atomic<uint32_t> consumer_waiting;
+    alignas(64) std::atomic<uint32_t> space_seq;
+    std::atomic<uint32_t> producer_waiting;
+};
+
+struct ShmHeader {
+    uint32_t magic;
+    uint32_t spin;
+    uint64_t capacity;
+    std::atomic<uint32_t> closed;
+
+    ShmRing rings[2];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory needs lock-free atomics.");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared memory needs lock-free atomics.");
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+static void futex_wait(std::atomic<uint32_t>& word, uint32_t expected)
+{
+    struct timespec timeout = {0, SLEEP_TIMEOUT_NS};
+    syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>& word)
+{ syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAKE, 1, NULL, NULL, 0); }
+
+// Full barrier between this side's last store and its load of the other side's flag.
+// ThreadSanitizer doesn't support fences (-Wtsan), under it a seq_cst read-modify-write of the flag does the same.
+static uint32_t fenced_load(std::atomic<uint32_t>& flag)
+{
+#if defined(__SANITIZE_THREAD__)
+    return flag.fetch_or(0, std::memory_order_seq_cst);
+#else
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return flag.load(std::memory_order_relaxed);
+#endif
+}
+
+static void fenced_store(std::atomic<uint32_t>& flag, uint32_t value)
+{
+#if defined(__SANITIZE_THREAD__)
+    flag.exchange(value, std::memory_order_seq_cst);
+#else
+    flag.store(value, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Wakes the other side if it sleeps on the futex word. The barrier pairs with the one in wait():
+// either the sleeper sees the published data or this side sees that it's going to sleep.
+static void notify(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting)
+{
+    if(fenced_load(waiting)) {
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(seq);
+    }
+}
+
+ShmChannel::ShmChannel(size_t ring_capacity, bool _spin)
+    :positions{0, 0}, max_message(MAX_MESSAGE_SIZE), server_side(true), peer(-1)
+{
+    if(ring_capacity > MAX_RING_SIZE) {
+        throw ShmError("Shared memory ring can't be larger than 1 GiB.");
+    }
+
+    size_t ring_size = MIN_RING_SIZE;
+    while(ring_size < ring_capacity)
+        ring_size <<= 1;
+
+    fd = memfd_create("tcpserver-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd < 0) {
+        throw ShmError("Shared memory segment creation failed.");
+    }
+
+    // the session gets the descriptor too, the seals keep it from resizing the memory under the server.
+    size = sizeof(ShmHeader) + 2 * ring_size;
+    if(ftruncate(fd, size) < 0 || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        ::close(fd);
+        throw ShmError("Shared memory segment can't be resized.");
+    }
+
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapping == MAP_FAILED) {
+        ::close(fd);
+        throw ShmError("Shared memory segment can't be mapped.");
+    }
+
+    // the segment is zero-filled, so the atomics start from zero.
+    header = (ShmHeader*) mapping;
+    header->spin = _spin;
+    header->capacity = ring_size;
+    header->magic = SHM_MAGIC;
+
+    capacity = ring_size;
+    spin = _spin;
+    map_rings();
+}
+
+ShmChannel::ShmChannel(int segment)
+    :fd(-1), positions{0, 0}, max_message(MAX_MESSAGE_SIZE), server_side(false), peer(-1)
+{
+    // a segment that can shrink would fault this side on the next access.
+    struct stat st;
+    int seals = fcntl(segment, F_GET_SEALS);
+    if(seals < 0 || !(seals & F_SEAL_SHRINK)) {
+        throw ShmError("Shared memory segment isn't sealed.");
+    }
+    if(fstat(segment, &st) < 0 || !S_ISREG(st.st_mode) || (size_t) st.st_size < sizeof(ShmHeader)) {
+        throw ShmError("Shared memory segment is invalid.");
+    }
+    size = st.st_size;
+
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, segment, 0);
+    if(mapping == MAP_FAILED) {
+        throw ShmError("Shared memory segment can't be mapped.");
+    }
+
+    // the settings are read once, the other side can't change them for this side afterwards.
+    header = (ShmHeader*) mapping;
+    capacity = header->capacity;
+    spin = header->spin;
+
+    // the size is bounded first, so doubling it can't overflow.
+    bool power_of_two = capacity >= MIN_RING_SIZE && capacity <= MAX_RING_SIZE && (capacity & (capacity - 1)) == 0;
+    if(header->magic != SHM_MAGIC || !power_of_two || size - sizeof(ShmHeader) != 2 * capacity) {
+        munmap(header, size);
+        throw ShmError("Shared memory segment is invalid.");
+    }
+
+    // a fresh segment has empty rings.
+    for(ShmRing& ring : header->rings) {
+        if(ring.head.load() != 0 || ring.tail.load() != 0) {
+            munmap(header, size);
+            throw ShmError("Shared memory segment is invalid.");
+        }
+    }
+
+    map_rings();
+}
+
+void ShmChannel::map_rings()
+{
+    char* data = (char*) (header + 1);
+    rings[REQUESTS] = data;
+    rings[RESPONSES] = data + capacity;
+}
+
+ShmChannel::~ShmChannel()
+{
+    close();
+    munmap(header, size);
+
+    if(fd >= 0)
+        ::close(fd);
+}
+
+void ShmChannel::close()
+{
+    header->closed.store(1, std::memory_order_release);
+
+    for(ShmRing& ring : header->rings) {
+        for(std::atomic<uint32_t>* seq : {&ring.data_seq, &ring.space_seq}) {
+            seq->fetch_add(1, std::memory_order_seq_cst);
+            futex_wake(*seq);
+        }
+    }
+}
+
+bool ShmChannel::peer_gone()
+{
+    if(peer < 0)
+        return false;
+
+    struct pollfd pfd = {peer, POLLRDHUP, 0};
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL));
+}
+
+template<typename Ready>
+bool ShmChannel::wait(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting, Ready ready)
+{
+    for(uint64_t i = 0; ; i++) {
+        if(ready())
+            return true;
+        if(header->closed.load(std::memory_order_acquire))
+            return false;
+
+        // on a single CPU spinning only delays the peer, so the side sleeps or yields at once.
+        if(spin || (i < SPIN_LIMIT && !single_cpu)) {
+            if(single_cpu || i % YIELD_INTERVAL == YIELD_INTERVAL - 1)
+                sched_yield();
+            else
+                cpu_relax();
+            if(i % PEER_CHECK_INTERVAL == PEER_CHECK_INTERVAL - 1 && peer_gone())
+                return false;
+            continue;
+        }
+
+        // announces the sleep, then checks once more, so a notification can't be missed.
+        uint32_t observed = seq.load(std::memory_order_seq_cst);
+        fenced_store(waiting, 1);
+
+        if(!ready() && !header->closed.load(std::memory_order_acquire))
+            futex_wait(seq, observed);
+
+        waiting.store(0, std::memory_order_relaxed);
+        if(peer_gone())
+            return false;
+    }
+}
+
+bool ShmChannel::write(int index, const char* src, size_t bytes)
+{
+    ShmRing& ring = header->rings[index];
+    char* data = rings[index];
+
+    uint64_t& head = positions[index];
+    while(bytes > 0) {
+        uint64_t tail;
+        auto has_space = [&] {
+            tail = ring.tail.load(std::memory_order_acquire);
+            return head - tail != capacity;
+        };
+        if(!wait(ring.space_seq, ring.producer_waiting, has_space))
+            return false;
+
+        // the consumer can't be ahead of the producer or further behind than the ring size.
+        if(head - tail > capacity) {
+            close();
+            return false;
+        }
+
+        // copies as much as fits, in two parts if the free space wraps around.
+        size_t chunk = std::min((uint64_t) bytes, capacity - (head - tail));
+        size_t offset = head & (capacity - 1);
+        size_t first = std::min(chunk, capacity - offset);
+        memcpy(data + offset, src, first);
+        memcpy(data, src + first, chunk - first);
+
+        head += chunk;
+        src += chunk;
+        bytes -= chunk;
+
+        ring.head.store(head, std::memory_order_release);
+        notify(ring.data_seq, ring.consumer_waiting);
+    }
+
+    return true;
+}
+
+bool ShmChannel::read(int index, char* dst, size_t bytes)
+{
+    ShmRing& ring = header->rings[index];
+    char* data = rings[index];
+
+    uint64_t& tail = positions[index];
+    while(bytes > 0) {
+        uint64_t head;
+        auto has_data = [&] {
+            head = ring.head.load(std::memory_order_acquire);
+            return head != tail;
+        };
+        if(!wait(ring.data_seq, ring.consumer_waiting, has_data))
+            return false;
+
+        // the producer can't be behind the consumer or publish more than the ring holds.
+        if(head - tail > capacity) {
+            close();
+            return false;
+        }
+
+        size_t chunk = std::min((uint64_t) bytes, head - tail);
+        size_t offset = tail & (capacity - 1);
+        size_t first = std::min(chunk, capacity - offset);
+        memcpy(dst, data + offset, first);
+        memcpy(dst + first, data, chunk - first);
+
+        tail += chunk;
+        dst += chunk;
+        bytes -= chunk;
+
+        ring.tail.store(tail, std::memory_order_release);
+        notify(ring.space_seq, ring.producer_waiting);
+    }
+
+    return true;
+}
+
+bool ShmChannel::send(const char* data, size_t bytes)
+{
+    int ring = server_side ? RESPONSES : REQUESTS;
+
+    if(bytes > UINT32_MAX || header->closed.load(std::memory_order_acquire))
+        return false;
+
+    uint32_t length = bytes;
+    return write(ring, (const char*) &length, sizeof(length)) && write(ring, data, bytes);
+}
+
+int ShmChannel::receive(std::string& result)
+{
+    int ring = server_side ? REQUESTS : RESPONSES;
+
+    uint32_t length;
+    if(!read(ring, (char*) &length, sizeof(length)))
+        return 0;
+
+    if(length > max_message) {
+        close();
+        return 0;
+    }
+
+    result.resize(length);
+    if(!read(ring, &result[0], length))
+        return 0;
+
+    return 1;
+}
+
+
+static const std::string SHM_COMMAND = std::string(1, CONTROL_BYTE) + "SHM ";
+// Goes before the answer, the descriptor of an accepted channel is attached to it.
+static const char SHM_MARKER = 'S';
+
+std::string shm_offer(size_t capacity, bool spin)
+{ return SHM_COMMAND + std::to_string(capacity) + (spin ? " spin" : " wait"); }
+
+bool parse_shm_offer(const std::string& request, size_t& capacity, bool& spin)
+{
+    if(request.compare(0, SHM_COMMAND.size(), SHM_COMMAND) != 0)
+        return false;
+
+    std::istringstream fields(request.substr(SHM_COMMAND.size()));
+    std::string mode, rest;
+    if(!(fields >> capacity >> mode) || (mode != "spin" && mode != "wait") || (fields >> rest))
+        return false;
+
+    spin = mode == "spin";
+    return true;
+}
+
+std::string shm_answer(bool accepted)
+{ return SHM_COMMAND + (accepted ? "ok" : "declined"); }
+
+bool parse_shm_answer(const std::string& answer)
+{ return answer == shm_answer(true); }
+
+bool send_shm_segment(int sock, int segment)
+{
+    char marker = SHM_MARKER;
+    struct iovec iov = {&marker, 1};
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    if(segment >= 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &segment, sizeof(int));
+    }
+
+    ssize_t bytes;
+    do {
+        bytes = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while(bytes < 0 && errno == EINTR);
+
+    return bytes == 1;
+}
+
+bool receive_shm_segment(int sock, int& segment)
+{
+    segment = -1;
+
+    char marker;
+    struct iovec iov = {&marker, 1};
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t bytes;
+    do {
+        bytes = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while(bytes < 0 && errno == EINTR);
+
+    if(bytes != 1 || marker != SHM_MARKER)
+        return false;
+
+    for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            memcpy(&segment, CMSG_DATA(cmsg), sizeof(int));
+    }
+
+    // a truncated control message could have dropped descriptors, the channel isn't used then.
+    if(msg.msg_flags & MSG_CTRUNC) {
+        if(segment >= 0)
+            ::close(segment);
+        segment = -1;
+    }
+    return true;
+}
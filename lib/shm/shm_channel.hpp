@@ -0,0 +1,115 @@
+#ifndef SHM_CHANNEL_HPP
+#define SHM_CHANNEL_HPP
+
+#include <string>
+#include <exception>
+
+#include <atomic>
+#include <cstdint>
+
+/*
+    Shared-memory transport between a session and the server on the same host.
+
+    The channel is a memory-mapped segment with two single-producer single-consumer
+    byte rings: one for requests and one for responses. A message is its 4-byte size followed by
+    the payload, so messages larger than a ring are streamed through it.
+
+    A side that waits for data or free space spins for a while and then sleeps on a futex,
+    the other side wakes it only if it's really sleeping. In spin mode the sides never sleep,
+    which gives the lowest latency at the cost of one busy core per side.
+
+    The session asks for a channel over a Unix domain socket. The server creates the segment as a sealed memfd
+    and passes the descriptor back over the socket, so the session can't shrink the memory the server has mapped.
+    The socket then only tells the sides that the peer is gone.
+
+    The other side can write anything into the segment, so the geometry of the rings is copied
+    when the segment is mapped and every position read from the segment is checked against it.
+    A side that finds an impossible position or a message over the limit closes the channel.
+*/
+
+struct ShmHeader;
+
+class ShmChannel {
+    ShmHeader* header;
+    size_t size;
+    // the memfd of the segment, kept by the side that created it.
+    int fd;
+
+    // private copies of the segment settings, the copies in the segment aren't trusted.
+    uint64_t capacity;
+    bool spin;
+    char* rings[2];
+    // the position this side owns in each ring: head of the ring it writes, tail of the ring it reads.
+    uint64_t positions[2];
+
+    size_t max_message;
+
+    bool server_side;
+    int peer;
+
+    void map_rings();
+
+    bool peer_gone();
+
+    template<typename Ready>
+    bool wait(std::atomic<uint32_t>&, std::atomic<uint32_t>&, Ready);
+
+    bool write(int ring, const char*, size_t);
+    bool read(int ring, char*, size_t);
+public:
+    class ShmError : public std::exception {
+        std::string msg;
+    public:
+        ShmError(const std::string& _msg)
+            :msg(_msg)
+        {}
+
+        const char* what() const noexcept
+        { return msg.c_str(); }
+    };
+
+    // Creates a new segment (server side).
+    ShmChannel(size_t capacity, bool spin);
+    // Maps the segment received from the server (session side), the descriptor stays owned by the caller.
+    ShmChannel(int segment);
+
+    ShmChannel(ShmChannel&) = delete;
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel(ShmChannel&&) = delete;
+
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    ~ShmChannel();
+
+    // Descriptor of the segment to pass to the session, -1 on the session side.
+    int get_fd() const
+    { return fd; }
+
+    // Socket connected to the other side, the channel is closed when it's hung up.
+    void set_peer(int fd)
+    { peer = fd; }
+
+    // Messages longer than `bytes` close the channel instead of being received.
+    void set_max_message(size_t bytes)
+    { max_message = bytes; }
+
+    // Returns false if the channel is closed or the message is longer than 4 GiB.
+    bool send(const char*, size_t);
+    // Returns 1 if a message is received, 0 if the channel is closed.
+    int receive(std::string&);
+
+    void close();
+};
+
+// Control requests of the shared-memory handshake.
+std::string shm_offer(size_t capacity, bool spin);
+bool parse_shm_offer(const std::string&, size_t& capacity, bool& spin);
+std::string shm_answer(bool accepted);
+bool parse_shm_answer(const std::string&);
+
+// The byte sent before the answer, with the segment attached if it isn't -1. Needs a Unix domain socket.
+bool send_shm_segment(int sock, int segment);
+// Returns false if the byte isn't received, `segment` is -1 if no descriptor came with it.
+bool receive_shm_segment(int sock, int& segment);
+
+#endif // SHM_CHANNEL_HPP
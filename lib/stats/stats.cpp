@@ -0,0 +1,117 @@
+#include "stats.hpp"
+
+#include <string.h>
+
+#include <chrono>
+
+uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Histogram::Histogram()
+    :sum_ns(0), count(0)
+{
+    for(int i = 0; i <= BUCKETS; i++)
+        buckets[i].store(0);
+}
+
+void Histogram::record(uint64_t ns)
+{
+    uint64_t us = (ns + 999) / 1000;
+    int bucket = us <= 1 ? 0 : 64 - __builtin_clzll(us - 1);
+    if(bucket > BUCKETS)
+        bucket = BUCKETS;
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Histogram::render(std::ostream& os, const std::string& name, const std::string& help) const
+{
+    os << "# HELP " << name << " " << help << "\n"
+       << "# TYPE " << name << " histogram\n";
+
+    uint64_t cumulative = 0;
+    for(int i = 0; i < BUCKETS; i++) {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        os << name << "_bucket{le=\"" << (double) (1ULL << i) / 1e6 << "\"} " << cumulative << "\n";
+    }
+    cumulative += buckets[BUCKETS].load(std::memory_order_relaxed);
+
+    os << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n"
+       << name << "_sum " << sum_ns.load(std::memory_order_relaxed) / 1e9 << "\n"
+       << name << "_count " << count.load(std::memory_order_relaxed) << "\n";
+}
+
+TraceRing::TraceRing(size_t capacity, int _sample_every)
+    :head(0), requests(0), sample_every(_sample_every > 0 ? _sample_every : 1)
+{
+    size_t size = 1;
+    while(size < capacity)
+        size <<= 1;
+
+    slots.reset(new Slot[size]);
+    mask = size - 1;
+}
+
+bool TraceRing::sample()
+{ return requests.fetch_add(1, std::memory_order_relaxed) % sample_every == 0; }
+
+void TraceRing::push(TraceRecord record)
+{
+    uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+    record.id = index;
+
+    uint64_t fields[FIELDS];
+    memcpy(fields, &record, sizeof(record));
+
+    // the release stores keep the odd seq ahead of the fields without a fence, which ThreadSanitizer can't check.
+    Slot& slot = slots[index & mask];
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+
+    for(int i = 0; i < FIELDS; i++)
+        slot.fields[i].store(fields[i], std::memory_order_release);
+
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+std::vector<TraceRecord> TraceRing::snapshot() const
+{
+    std::vector<TraceRecord> result;
+
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end > mask + 1 ? end - (mask + 1) : 0;
+    for(uint64_t index = begin; index < end; index++) {
+        const Slot& slot = slots[index & mask];
+
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if(seq != 2 * index + 2)
+            continue;
+
+        // the acquire loads keep the second seq load after them, a field of a newer record makes it differ.
+        uint64_t fields[FIELDS];
+        for(int i = 0; i < FIELDS; i++)
+            fields[i] = slot.fields[i].load(std::memory_order_acquire);
+
+        // the record was overwritten while it was being copied.
+        if(slot.seq.load(std::memory_order_relaxed) != seq)
+            continue;
+
+        TraceRecord record;
+        memcpy(&record, fields, sizeof(record));
+        result.push_back(record);
+    }
+
+    return result;
+}
+
+void render_metric(std::ostream& os, const std::string& name, const std::string& type,
+                   const std::string& help, uint64_t value)
+{
+    os << "# HELP " << name << " " << help << "\n"
+       << "# TYPE " << name << " " << type << "\n"
+       << name << " " << value << "\n";
+}
@@ -0,0 +1,111 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <ostream>
+
+#include <atomic>
+#include <cstdint>
+
+/*
+    Live server metrics and sampled request traces.
+
+    Histogram keeps latencies in power-of-two microsecond buckets and renders them
+    in Prometheus text format. TraceRing stores sampled per-request timestamps in a fixed ring
+    that is written without locks; the oldest records are overwritten.
+*/
+
+// Monotonic time in nanoseconds.
+uint64_t now_ns();
+
+class Histogram {
+    // bucket i counts values up to 2^i microseconds, the last one counts the rest.
+    static const int BUCKETS = 24;
+
+    std::atomic<uint64_t> buckets[BUCKETS + 1];
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> count;
+public:
+    Histogram();
+
+    Histogram(Histogram&) = delete;
+    Histogram(const Histogram&) = delete;
+    Histogram(Histogram&&) = delete;
+
+    Histogram& operator=(const Histogram&) = delete;
+
+    void record(uint64_t ns);
+
+    void render(std::ostream&, const std::string& name, const std::string& help) const;
+};
+
+struct ServerMetrics {
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<int64_t> active_connections{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> bytes_out{0};
+
+    // time spent in the handler (including cache, coalescing and batching),
+    // time spent reading and writing, and the whole request.
+    Histogram handler_time;
+    Histogram io_time;
+    Histogram request_time;
+};
+
+// Timestamps are now_ns() values.
+// accept, queued and dequeued are set only in the first request of a connection, queued and dequeued in parallel mode.
+struct TraceRecord {
+    uint64_t id;
+    uint64_t clientfd;
+    uint64_t accept;
+    // the connection waited in the thread pool queue between these two.
+    uint64_t queued;
+    uint64_t dequeued;
+    uint64_t first_byte;
+    uint64_t full_frame;
+    uint64_t handler_start;
+    uint64_t handler_end;
+    uint64_t last_byte;
+    uint64_t request_bytes;
+    uint64_t response_bytes;
+};
+
+class TraceRing {
+    static const int FIELDS = sizeof(TraceRecord) / sizeof(uint64_t);
+
+    // seq is odd while the slot is being written, so readers skip torn records.
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> fields[FIELDS];
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> requests;
+    int sample_every;
+public:
+    TraceRing(size_t capacity, int sample_every);
+
+    TraceRing(TraceRing&) = delete;
+    TraceRing(const TraceRing&) = delete;
+    TraceRing(TraceRing&&) = delete;
+
+    TraceRing& operator=(const TraceRing&) = delete;
+
+    // Returns true for every sample_every-th request.
+    bool sample();
+
+    void push(TraceRecord);
+
+    std::vector<TraceRecord> snapshot() const;
+};
+
+void render_metric(std::ostream&, const std::string& name, const std::string& type,
+                   const std::string& help, uint64_t value);
+
+#endif // STATS_HPP
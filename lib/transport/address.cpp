@@ -0,0 +1,114 @@
+#include "address.hpp"
+
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <unistd.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <sstream>
+
+static const std::string UNIX_PREFIX = "unix:";
+
+bool parse_address(const std::string& host, unsigned short port, Address& addr)
+{
+    memset(&addr.storage, 0, sizeof(addr.storage));
+    addr.path.clear();
+
+    if(host.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+        std::string name = host.substr(UNIX_PREFIX.size());
+        struct sockaddr_un* un = (struct sockaddr_un*) &addr.storage;
+        if(name.empty() || name.size() >= sizeof(un->sun_path))
+            return false;
+
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, name.data(), name.size());
+
+        // the abstract name starts with the null byte instead of '@' and isn't null-terminated.
+        if(name[0] == '@')
+            un->sun_path[0] = '\0';
+        else
+            addr.path = name;
+
+        addr.family = AF_UNIX;
+        addr.length = offsetof(struct sockaddr_un, sun_path) + name.size() + (name[0] == '@' ? 0 : 1);
+        return true;
+    }
+
+    if(host.find(':') != std::string::npos) {
+        std::string ip = host;
+        if(ip.size() > 2 && ip.front() == '[' && ip.back() == ']')
+            ip = ip.substr(1, ip.size() - 2);
+
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*) &addr.storage;
+        if(inet_pton(AF_INET6, ip.c_str(), &in6->sin6_addr) != 1)
+            return false;
+
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+
+        addr.family = AF_INET6;
+        addr.length = sizeof(struct sockaddr_in6);
+        return true;
+    }
+
+    struct sockaddr_in* in = (struct sockaddr_in*) &addr.storage;
+    if(inet_aton(host.c_str(), &in->sin_addr) == 0)
+        return false;
+
+    in->sin_family = AF_INET;
+    in->sin_port = htons(port);
+
+    addr.family = AF_INET;
+    addr.length = sizeof(struct sockaddr_in);
+    return true;
+}
+
+std::string format_address(const std::string& host, unsigned short port, const Address& addr)
+{
+    if(addr.is_unix())
+        return host;
+
+    std::ostringstream oss;
+    if(addr.family == AF_INET6 && host.front() != '[')
+        oss << "[" << host << "]:" << port;
+    else
+        oss << host << ":" << port;
+
+    return oss.str();
+}
+
+void peer_address(const struct sockaddr_storage& storage, std::string& host, unsigned short& port)
+{
+    char buffer[INET6_ADDRSTRLEN];
+
+    if(storage.ss_family == AF_INET6) {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*) &storage;
+        inet_ntop(AF_INET6, &in6->sin6_addr, buffer, sizeof(buffer));
+        host = buffer;
+        port = ntohs(in6->sin6_port);
+    }
+    else if(storage.ss_family == AF_INET) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*) &storage;
+        inet_ntop(AF_INET, &in->sin_addr, buffer, sizeof(buffer));
+        host = buffer;
+        port = ntohs(in->sin_port);
+    }
+    else {
+        // the clients of Unix domain sockets are usually unnamed.
+        host = "unix";
+        port = 0;
+    }
+}
+
+void remove_socket_file(const Address& addr)
+{
+    struct stat st;
+    if(addr.path.empty() || lstat(addr.path.c_str(), &st) < 0 || !S_ISSOCK(st.st_mode))
+        return;
+
+    unlink(addr.path.c_str());
+}
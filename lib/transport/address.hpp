@@ -0,0 +1,47 @@
+#ifndef ADDRESS_HPP
+#define ADDRESS_HPP
+
+#include <sys/socket.h>
+
+#include <string>
+
+/*
+    Socket address of any supported transport.
+
+    The host string selects the transport:
+        "127.0.0.1"       - TCP over IPv4.
+        "::1" or "[::1]"  - TCP over IPv6.
+        "unix:/path"      - Unix domain socket bound to a file.
+        "unix:@name"      - Unix domain socket in the abstract namespace (Linux), no file is created.
+    The port is ignored by Unix domain sockets.
+*/
+
+struct Address {
+    struct sockaddr_storage storage;
+    socklen_t length;
+    int family;
+
+    // filesystem path of a Unix domain socket, empty for other transports.
+    std::string path;
+
+    const struct sockaddr* sockaddr() const
+    { return (const struct sockaddr*) &storage; }
+
+    bool is_unix() const
+    { return family == AF_UNIX; }
+};
+
+// Returns false if the host can't be parsed.
+bool parse_address(const std::string& host, unsigned short port, Address&);
+
+// Formats the address as it's shown to the user: "ip:port", "[ipv6]:port" or "unix:path".
+std::string format_address(const std::string& host, unsigned short port, const Address&);
+
+// Removes the socket file of a Unix domain socket address.
+// Anything else at the path is kept, so a mistyped path can't delete a regular file.
+void remove_socket_file(const Address&);
+
+// Fills the host and port of a peer returned by accept().
+void peer_address(const struct sockaddr_storage&, std::string& host, unsigned short& port);
+
+#endif // ADDRESS_HPP
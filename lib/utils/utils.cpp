@@ -1,12 +1,18 @@
 #include "utils.hpp"
 
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <string.h>
+
 std::vector<std::string> chunks(const std::string& str, int chunk_size)
 {
     int chunks = std::ceil( (double) str.size() / chunk_size );
     std::vector<std::string> v(chunks, "");
 
     int i = 0;
-    for(int j = 0; j < str.size(); j++) {
+    for(int j = 0; j < (int) str.size(); j++) {
         if(j == chunk_size * (i+1)) {
             i++;
         }
@@ -14,4 +20,40 @@ std::vector<std::string> chunks(const std::string& str, int chunk_size)
     }
 
     return v;
-}
\ No newline at end of file
+}
+
+void set_nodelay(int sock)
+{
+    int enable = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+static inline uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t hash_bytes(const char* data, size_t size)
+{
+    const uint64_t k = 0x9e3779b97f4a7c15ULL;
+    uint64_t h = size * k;
+
+    // consumes the input by 8 bytes, the tail is packed into the last word.
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ mix(word)) * k;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    h = (h ^ mix(tail)) * k;
+
+    return mix(h);
+}
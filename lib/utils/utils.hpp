@@ -4,7 +4,17 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdint>
+
+// Marks requests that are addressed to the library itself, not to the handler.
+const char CONTROL_BYTE = '\x01';
 
 std::vector<std::string> chunks(const std::string&, int);
 
-#endif // UTILS_HPP
\ No newline at end of file
+// Disables Nagle's algorithm, so small messages aren't delayed waiting for ACKs.
+void set_nodelay(int);
+
+// Fast non-cryptographic 64-bit hash of a byte sequence.
+uint64_t hash_bytes(const char*, size_t);
+
+#endif // UTILS_HPP
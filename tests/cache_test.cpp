@@ -0,0 +1,90 @@
+#include "test.hpp"
+
+#include <thread>
+
+#include "../lib/cache/response_cache.hpp"
+
+/*
+    ResponseCache: hits and misses, TTL expiration, LRU eviction and the size limit.
+*/
+
+// Mirrors ENTRY_OVERHEAD of response_cache.cpp.
+#define ENTRY_OVERHEAD 128
+
+static ResponseCache::Response response(const std::string& body)
+{ return std::make_shared<const std::string>(body); }
+
+static void hits_and_misses()
+{
+    ResponseCache cache(1 << 20);
+
+    CHECK(cache.lookup("a") == nullptr);
+    cache.insert("a", response("A"));
+    CHECK(cache.lookup("a") && *cache.lookup("a") == "A");
+    CHECK(cache.lookup("b") == nullptr);
+
+    // the newer response replaces the old one.
+    cache.insert("a", response("AA"));
+    CHECK(*cache.lookup("a") == "AA");
+
+    ResponseCache::Stats stats = cache.stats();
+    CHECK(stats.hits == 3 && stats.misses == 2);
+    CHECK(stats.entries == 1 && stats.insertions == 2);
+
+    cache.clear();
+    CHECK(cache.lookup("a") == nullptr);
+    CHECK(cache.stats().bytes == 0);
+}
+
+static void ttl()
+{
+    ResponseCache cache(1 << 20, std::chrono::milliseconds(50));
+
+    cache.insert("a", response("A"));
+    CHECK(cache.lookup("a") != nullptr);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    CHECK(cache.lookup("a") == nullptr);
+
+    ResponseCache::Stats stats = cache.stats();
+    CHECK(stats.expirations == 1 && stats.entries == 0);
+}
+
+static void eviction()
+{
+    // one shard that fits exactly three entries of one-byte requests and 10-byte responses.
+    size_t charge = 1 + 10 + ENTRY_OVERHEAD;
+    ResponseCache cache(3 * charge, std::chrono::milliseconds(0), 1);
+
+    cache.insert("a", response(std::string(10, 'a')));
+    cache.insert("b", response(std::string(10, 'b')));
+    cache.insert("c", response(std::string(10, 'c')));
+    CHECK(cache.stats().bytes == 3 * charge);
+
+    // "a" becomes the most recently used, so "b" is evicted.
+    CHECK(cache.lookup("a") != nullptr);
+    cache.insert("d", response(std::string(10, 'd')));
+
+    CHECK(cache.lookup("b") == nullptr);
+    CHECK(cache.lookup("a") != nullptr);
+    CHECK(cache.lookup("c") != nullptr);
+    CHECK(cache.lookup("d") != nullptr);
+
+    ResponseCache::Stats stats = cache.stats();
+    CHECK(stats.evictions == 1 && stats.entries == 3);
+    CHECK(stats.bytes <= 3 * charge);
+
+    // a response larger than the shard isn't cached and doesn't evict anything.
+    cache.insert("e", response(std::string(4 * charge, 'e')));
+    CHECK(cache.lookup("e") == nullptr);
+    CHECK(cache.stats().entries == 3);
+}
+
+int main()
+{
+    hits_and_misses();
+    ttl();
+    eviction();
+
+    return report("cache_test");
+}
@@ -0,0 +1,164 @@
+#include "test.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "../lib/codec/codec.hpp"
+
+/*
+    Block framing of send_message() / receive_message() over a socket pair:
+    empty, small, exactly one block and multi-block messages with every codec of the build
+    (Codec::None in the default build), malformed headers and the negotiation requests.
+*/
+
+// Mirrors BLOCK_SIZE and HEADER_SIZE of codec.cpp.
+#define BLOCK_SIZE (64 * 1024)
+#define HEADER_SIZE 9
+
+static std::string pattern(size_t size)
+{
+    // compressible, but not a single repeated byte.
+    std::string result(size, ' ');
+    for(size_t i = 0; i < size; i++)
+        result[i] = 'a' + (i / 7) % 26;
+    return result;
+}
+
+static void round_trip(Codec codec)
+{
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    std::vector<size_t> sizes = {0, 1, 100, BLOCK_SIZE - 1, BLOCK_SIZE, BLOCK_SIZE + 1, 3 * BLOCK_SIZE + 123};
+
+    CompressionCounters sent, received;
+
+    // the socket buffer is smaller than the largest message, so the sender runs on its own thread.
+    std::thread sender([&] {
+        for(size_t size : sizes) {
+            std::string message = pattern(size);
+            CHECK(send_message(fds[0], message.data(), message.size(), codec, 64, sent));
+        }
+    });
+
+    for(size_t size : sizes) {
+        std::string message;
+        CHECK(receive_message(fds[1], message, received) == 1);
+        CHECK(message == pattern(size));
+    }
+    sender.join();
+
+    size_t total = 0;
+    for(size_t size : sizes)
+        total += size;
+
+    // each side counts only its own direction, both see the same bytes on the wire.
+    CompressionStats out = sent.snapshot();
+    CompressionStats in = received.snapshot();
+    CHECK(out.sent_messages == sizes.size() && out.received_messages == 0);
+    CHECK(in.received_messages == sizes.size() && in.sent_messages == 0);
+    CHECK(out.sent_raw_bytes == total && in.received_raw_bytes == total);
+    CHECK(out.sent_wire_bytes == in.received_wire_bytes);
+    CHECK(out.received_raw_bytes == 0 && in.sent_raw_bytes == 0);
+
+    // every block has a header, so the framing of the default build adds HEADER_SIZE per block.
+    if(codec == Codec::None) {
+        size_t blocks = 0;
+        for(size_t size : sizes)
+            blocks += size == 0 ? 1 : (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        CHECK(out.sent_wire_bytes == total + blocks * HEADER_SIZE);
+    }
+
+    // the messages below the threshold and the blocks of Codec::None are sent as is.
+    if(codec == Codec::None)
+        CHECK(sent.snapshot().compressed_blocks == 0);
+    else
+        CHECK(sent.snapshot().compressed_blocks > 0);
+
+    // the peer is gone.
+    close(fds[0]);
+    std::string message;
+    CHECK(receive_message(fds[1], message, received) == 0);
+    close(fds[1]);
+}
+
+static void malformed_blocks()
+{
+    CompressionCounters counters;
+    std::string message;
+
+    // a block larger than BLOCK_SIZE.
+    {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        char header[HEADER_SIZE] = {(char) 0x80, 0, 0x02, 0, 0, 0, 0x02, 0, 0};
+        CHECK(write(fds[0], header, HEADER_SIZE) == HEADER_SIZE);
+        CHECK(receive_message(fds[1], message, counters) == -1);
+
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    // an uncompressed block whose wire size differs from its raw size.
+    {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        char header[HEADER_SIZE] = {(char) 0x80, 0, 0, 0, 4, 0, 0, 0, 3};
+        CHECK(write(fds[0], header, HEADER_SIZE) == HEADER_SIZE);
+        CHECK(receive_message(fds[1], message, counters) == -1);
+
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    // the connection is closed in the middle of a block.
+    {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        char header[HEADER_SIZE] = {(char) 0x80, 0, 0, 0, 4, 0, 0, 0, 4};
+        CHECK(write(fds[0], header, HEADER_SIZE) == HEADER_SIZE);
+        CHECK(write(fds[0], "ab", 2) == 2);
+        close(fds[0]);
+        CHECK(receive_message(fds[1], message, counters) == 0);
+
+        close(fds[1]);
+    }
+}
+
+static void negotiation()
+{
+    std::string offer = compression_offer();
+    CHECK(!offer.empty() && offer[0] == CONTROL_BYTE);
+    CHECK(is_compression_offer(offer));
+    CHECK(!is_compression_offer(std::string(1, CONTROL_BYTE) + "COMPRESSED"));
+    CHECK(!is_compression_offer("COMPRESS lz4"));
+
+    // both sides are the same build, so the first codec of the build is chosen.
+    std::vector<Codec> codecs = supported_codecs();
+    CHECK(choose_codec(offer) == (codecs.empty() ? Codec::None : codecs[0]));
+    CHECK(choose_codec(std::string(1, CONTROL_BYTE) + "COMPRESS brotli") == Codec::None);
+
+    for(Codec codec : {Codec::None, Codec::LZ4, Codec::Zstd}) {
+        Codec parsed;
+        CHECK(parse_compression_answer(compression_answer(codec), parsed) && parsed == codec);
+    }
+    Codec parsed;
+    CHECK(!parse_compression_answer("hello", parsed));
+}
+
+int main()
+{
+    round_trip(Codec::None);
+    for(Codec codec : supported_codecs())
+        round_trip(codec);
+
+    malformed_blocks();
+    negotiation();
+
+    return report("codec_test");
+}
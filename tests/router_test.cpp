@@ -0,0 +1,104 @@
+#include "test.hpp"
+
+#include "../lib/router/router.hpp"
+
+/*
+    Router: perfect-hash token routes, opcode routes, rejected commands and StaticRouter dispatch.
+*/
+
+static Router::Handler reply(const std::string& prefix)
+{ return [prefix](const std::string& payload) { return prefix + payload; }; }
+
+static void token_routes()
+{
+    Router router;
+    CHECK(router.empty());
+    CHECK(router.match("get a") == -1);
+
+    // enough routes to make the perfect hash look for a seed and grow the table.
+    for(int i = 0; i < 200; i++)
+        router.add_route("cmd" + std::to_string(i), reply(std::to_string(i) + ":"));
+
+    for(int i = 0; i < 200; i++) {
+        int route = router.match("cmd" + std::to_string(i) + " payload");
+        CHECK(route >= 0);
+        CHECK(router.call(route, "cmd" + std::to_string(i) + " payload") == std::to_string(i) + ":payload");
+    }
+
+    // the command without payload matches, prefixes and extensions of a command don't.
+    CHECK(router.match("cmd7") >= 0);
+    CHECK(router.call(router.match("cmd7"), "cmd7") == "7:");
+    CHECK(router.match("cmd") == -1);
+    CHECK(router.match("cmd7x y") == -1);
+    CHECK(router.match("unknown y") == -1);
+    CHECK(router.match("") == -1);
+
+    std::vector<Router::RouteStats> stats = router.stats();
+    CHECK(stats.size() == 200);
+    CHECK(stats[7].command == "cmd7" && stats[7].count == 2);
+}
+
+static void token_delimiter()
+{
+    Router router(Router::Mode::Token, '|');
+    router.add_route("sort", reply("sorted "), false, true);
+
+    int route = router.match("sort|3 1 2");
+    CHECK(route >= 0);
+    CHECK(router.call(route, "sort|3 1 2") == "sorted 3 1 2");
+    CHECK(router.cacheable(route) && !router.coalesce(route));
+    CHECK(router.match("sort 3 1 2") == -1);
+}
+
+static void opcode_routes()
+{
+    Router router(Router::Mode::Opcode);
+    router.add_route("s", reply("s:"));
+    router.add_route("\xff", reply("ff:"), true);
+
+    CHECK(router.call(router.match("sabc"), "sabc") == "s:abc");
+    CHECK(router.call(router.match("\xff" "x"), "\xff" "x") == "ff:x");
+    CHECK(router.coalesce(router.match("\xff")));
+    CHECK(router.match("xabc") == -1);
+    CHECK(router.match("") == -1);
+}
+
+static void rejected_commands()
+{
+    Router token;
+    token.add_route("get", reply(""));
+    CHECK_THROWS(token.add_route("get", reply("")), Router::RouterError);
+    CHECK_THROWS(token.add_route("", reply("")), Router::RouterError);
+    CHECK_THROWS(token.add_route("a b", reply("")), Router::RouterError);
+    CHECK_THROWS(token.add_route(std::string(1, CONTROL_BYTE) + "x", reply("")), Router::RouterError);
+
+    Router opcode(Router::Mode::Opcode);
+    CHECK_THROWS(opcode.add_route("ab", reply("")), Router::RouterError);
+    CHECK_THROWS(opcode.add_route(std::string(1, CONTROL_BYTE), reply("")), Router::RouterError);
+    CHECK(opcode.empty());
+}
+
+static void static_router()
+{
+    StaticRouter router(route<'a'>([](const std::string& payload) { return "a:" + payload; }),
+                        route<'b'>([](const std::string& payload) { return "b:" + payload; }));
+
+    CHECK(router("axy") == "a:xy");
+    CHECK(router("b") == "b:");
+    CHECK(router("z") == "Unknown command.");
+    CHECK(router("") == "Unknown command.");
+
+    std::vector<Router::RouteStats> stats = router.stats();
+    CHECK(stats.size() == 2 && stats[0].count == 1 && stats[1].count == 1);
+}
+
+int main()
+{
+    token_routes();
+    token_delimiter();
+    opcode_routes();
+    rejected_commands();
+    static_router();
+
+    return report("router_test");
+}
@@ -0,0 +1,237 @@
+#include "test.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+#include <cstring>
+#include <cstddef>
+
+#include "../lib/shm/shm_channel.hpp"
+
+/*
+    ShmChannel: messages that wrap around the end of the rings, messages larger than a ring,
+    closing of the channel, sealing and passing of the segment, segments corrupted by the other side
+    and the handshake requests.
+    Both sides of the channel live in this process.
+*/
+
+static std::string pattern(size_t size, int seed)
+{
+    std::string result(size, ' ');
+    for(size_t i = 0; i < size; i++)
+        result[i] = 'a' + (i + seed) % 26;
+    return result;
+}
+
+static void wrap_around()
+{
+    // the smallest ring, 4 KiB.
+    ShmChannel server(1, false);
+    ShmChannel session(server.get_fd());
+
+    // odd sizes, so the messages and their size prefixes start at every offset of the ring.
+    size_t total = 0;
+    for(int i = 0; i < 2000; i++) {
+        std::string request = pattern(1 + (i * 37) % 3000, i);
+        CHECK(session.send(request.data(), request.size()));
+
+        std::string received;
+        CHECK(server.receive(received) == 1);
+        CHECK(received == request);
+
+        std::string response = pattern(1 + (i * 53) % 2000, -i);
+        CHECK(server.send(response.data(), response.size()));
+        CHECK(session.receive(received) == 1);
+        CHECK(received == response);
+
+        total += request.size();
+    }
+    CHECK(total > 100 * 4096);
+
+    // an empty message.
+    CHECK(session.send("", 0));
+    std::string received = "x";
+    CHECK(server.receive(received) == 1);
+    CHECK(received.empty());
+}
+
+static void larger_than_ring()
+{
+    ShmChannel server(4096, false);
+    ShmChannel session(server.get_fd());
+
+    // the message is streamed through the ring while the other side reads it.
+    std::string message = pattern(1 << 20, 7);
+    std::thread sender([&] {
+        for(int i = 0; i < 3; i++)
+            CHECK(session.send(message.data(), message.size()));
+    });
+
+    for(int i = 0; i < 3; i++) {
+        std::string received;
+        CHECK(server.receive(received) == 1);
+        CHECK(received == message);
+    }
+    sender.join();
+}
+
+static void closing()
+{
+    ShmChannel server(4096, false);
+    ShmChannel session(server.get_fd());
+
+    // the receiver sleeps until the other side closes the channel.
+    std::thread closer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        session.close();
+    });
+
+    std::string received;
+    CHECK(server.receive(received) == 0);
+    closer.join();
+    CHECK(!server.send("x", 1));
+
+    CHECK_THROWS(ShmChannel(-1), ShmChannel::ShmError);
+}
+
+// Header fields as the server lays them out: magic, spin, capacity.
+struct RawHeader {
+    uint32_t magic;
+    uint32_t spin;
+    uint64_t capacity;
+};
+
+static void set_capacity(int segment, uint64_t capacity)
+{ CHECK(pwrite(segment, &capacity, sizeof(capacity), offsetof(RawHeader, capacity)) == sizeof(capacity)); }
+
+// A sealed memfd of `size` bytes that starts with the header of `original`.
+static int forge(const ShmChannel& original, size_t size)
+{
+    int segment = memfd_create("shm_test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    CHECK(ftruncate(segment, size) == 0);
+
+    RawHeader header;
+    CHECK(pread(original.get_fd(), &header, sizeof(header), 0) == sizeof(header));
+    CHECK(pwrite(segment, &header, sizeof(header), 0) == sizeof(header));
+
+    CHECK(fcntl(segment, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) == 0);
+    return segment;
+}
+
+static void sealing()
+{
+    ShmChannel server(4096, false);
+
+    // the session gets the same descriptor, it can't shrink the memory under the server.
+    struct stat st;
+    CHECK(fstat(server.get_fd(), &st) == 0);
+    CHECK(ftruncate(server.get_fd(), st.st_size / 2) < 0);
+    CHECK(ftruncate(server.get_fd(), st.st_size * 2) < 0);
+
+    // an unsealed segment isn't mapped.
+    int unsealed = memfd_create("shm_test", MFD_CLOEXEC);
+    CHECK(ftruncate(unsealed, st.st_size) == 0);
+    CHECK_THROWS(ShmChannel{unsealed}, ShmChannel::ShmError);
+    close(unsealed);
+
+    // the segment is passed over a Unix domain socket.
+    int pair[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+
+    int segment;
+    CHECK(send_shm_segment(pair[0], server.get_fd()));
+    CHECK(receive_shm_segment(pair[1], segment));
+    CHECK(segment >= 0);
+
+    ShmChannel session(segment);
+    close(segment);
+
+    CHECK(session.send("ping", 4));
+    std::string received;
+    CHECK(server.receive(received) == 1);
+    CHECK(received == "ping");
+
+    // the declined offer has no descriptor.
+    CHECK(send_shm_segment(pair[0], -1));
+    CHECK(receive_shm_segment(pair[1], segment));
+    CHECK(segment == -1);
+
+    close(pair[0]);
+    close(pair[1]);
+}
+
+static void corrupted()
+{
+    // a ring size that isn't a power of two.
+    {
+        ShmChannel server(4096, false);
+        set_capacity(server.get_fd(), 3000);
+        CHECK_THROWS(ShmChannel(server.get_fd()), ShmChannel::ShmError);
+    }
+
+    // a ring size larger than the segment.
+    {
+        ShmChannel server(4096, false);
+        set_capacity(server.get_fd(), 1 << 20);
+        CHECK_THROWS(ShmChannel(server.get_fd()), ShmChannel::ShmError);
+    }
+
+    // a ring size whose double overflows, in a segment that holds only the header.
+    {
+        ShmChannel server(4096, false);
+        struct stat st;
+        CHECK(fstat(server.get_fd(), &st) == 0);
+
+        int segment = forge(server, st.st_size - 2 * 4096);
+        set_capacity(segment, 1ULL << 63);
+        CHECK_THROWS(ShmChannel{segment}, ShmChannel::ShmError);
+        close(segment);
+    }
+
+    // the size prefix of a message over the limit drops the channel.
+    {
+        ShmChannel server(4096, false);
+        ShmChannel session(server.get_fd());
+        server.set_max_message(1024);
+
+        std::string message(2048, 'x');
+        std::thread sender([&] { session.send(message.data(), message.size()); });
+
+        std::string received;
+        CHECK(server.receive(received) == 0);
+        CHECK(received.empty());
+        CHECK(!session.send("x", 1));
+        sender.join();
+    }
+}
+
+static void handshake()
+{
+    size_t capacity;
+    bool spin;
+    CHECK(parse_shm_offer(shm_offer(1 << 20, true), capacity, spin));
+    CHECK(capacity == 1 << 20 && spin);
+    CHECK(parse_shm_offer(shm_offer(4096, false), capacity, spin));
+    CHECK(capacity == 4096 && !spin);
+    CHECK(!parse_shm_offer("SHM 4096 wait", capacity, spin));
+    CHECK(!parse_shm_offer(shm_offer(4096, false) + " x", capacity, spin));
+
+    CHECK(parse_shm_answer(shm_answer(true)));
+    CHECK(!parse_shm_answer(shm_answer(false)));
+}
+
+int main()
+{
+    wrap_around();
+    larger_than_ring();
+    closing();
+    sealing();
+    corrupted();
+    handshake();
+
+    return report("shm_test");
+}
@@ -0,0 +1,47 @@
+#ifndef TEST_HPP
+#define TEST_HPP
+
+#include <string>
+#include <iostream>
+
+/*
+    Checks shared by the tests.
+
+    A failed check is reported with its location and the test goes on,
+    the exit code of the test is the number of failed checks (0 if all passed).
+*/
+
+static int failed_checks = 0;
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if(!(condition)) {                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            failed_checks++;                                                                \
+        }                                                                                   \
+    } while(0)
+
+// Checks that `statement` throws `Error`.
+#define CHECK_THROWS(statement, Error)  \
+    do {                                \
+        bool thrown = false;            \
+        try {                           \
+            statement;                  \
+        }                               \
+        catch(const Error&) {           \
+            thrown = true;              \
+        }                               \
+        CHECK(thrown && #statement);    \
+    } while(0)
+
+inline int report(const std::string& name)
+{
+    if(failed_checks > 0)
+        std::cout << name << ": " << failed_checks << " checks failed" << std::endl;
+    else
+        std::cout << name << ": passed" << std::endl;
+
+    return failed_checks > 0 ? 1 : 0;
+}
+
+#endif // TEST_HPP